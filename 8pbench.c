@@ -0,0 +1,499 @@
+/* See LICENSE file for copyright and license details. */
+
+/* 8pbench: run a scenario of 8p against a stand-in API and compare the
+ * measurements of its phases with a baseline
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <err.h>
+#include <ftw.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIXES		12	/* Mixes in the search results */
+#define MIXTRACKS	8	/* Tracks in a mix */
+#define MIXSLOTS	4096	/* Mixes the server keeps the position of */
+#define RATE		8000	/* Samples per second of the audio */
+#define PHASES		16
+#define THRESHOLD	10	/* Percent a phase may get slower */
+#define TIMEOUT		600	/* Seconds a run may take */
+#define TRACKS		1000	/* Track changes of the default scenario */
+
+enum metrics {M_WALL, M_CPU, M_CTXSW, M_MISSES, M_INSTR, METRICS};
+
+/* The sums of all occurrences of a phase, -1 when not measured */
+struct phase {
+	char	name[32];
+	int	count;
+	double	sum[METRICS];
+};
+
+static int	compare(const struct phase *, int, const struct phase *, int,
+		    int);
+static void	put32(unsigned char *, unsigned long);
+static int	readphases(FILE *, struct phase *, int, FILE *);
+static void	reply(int, int, const char *, const char *, const char *,
+		    size_t);
+static void	respond(int, int);
+static int	rm(const char *, const struct stat *, int, struct FTW *);
+static void	serve(int, int);
+static void	usage(void);
+static void	wav(void);
+static int	writephases(const char *, const struct phase *, int);
+
+static const char *names[METRICS] = {"wall ms", "cpu ms", "ctxsw",
+    "misses", "instructions"};
+
+/* One second of silence, served for every track */
+static unsigned char	audio[44 + RATE];
+
+/* The stand-in API keeps the track number of each mix, like 8tracks */
+static int		position[MIXSLOTS];
+
+int
+main(int argc, char *argv[])
+{
+	struct phase cur[PHASES], base[PHASES];
+	struct sockaddr_in sin;
+	socklen_t len;
+	pid_t server, run;
+	FILE *fp;
+	const char *prog, *output, *basepath, *tmp;
+	const char *args[10];
+	char dir[PATH_MAX], script[PATH_MAX], api[64];
+	long l;
+	char *ep;
+	int ch, fd, pfd[2], port, i, j, n, nbase, status, failed;
+	int keep, save, threshold, timeout, tracks;
+
+	prog = "8p";
+	output = NULL;
+	basepath = NULL;
+	keep = 0;
+	save = 0;
+	threshold = THRESHOLD;
+	timeout = TIMEOUT;
+	tracks = TRACKS;
+	while ((ch = getopt(argc, argv, "b:kn:o:t:T:wx:")) != -1) {
+		switch (ch) {
+		case 'b':	basepath = optarg; break;
+		case 'k':	keep = 1; break;
+		case 'o':	output = optarg; break;
+		case 'w':	save = 1; break;
+		case 'x':	prog = optarg; break;
+		case 'n':	/* FALLTHROUGH */
+		case 't':	/* FALLTHROUGH */
+		case 'T':
+			l = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || l < 1 ||
+			    l > 1000000)
+				errx(1, "invalid number: %s", optarg);
+			if (ch == 'n')
+				tracks = (int)l;
+			else if (ch == 't')
+				threshold = (int)l;
+			else
+				timeout = (int)l;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc > 1 || (save == 1 && basepath == NULL))
+		usage();
+
+	/* Every run starts with empty caches of its own */
+	tmp = getenv("TMPDIR");
+	(void)snprintf(dir, sizeof(dir), "%s/8pbench.XXXXXX",
+	    tmp != NULL && *tmp != '\0' ? tmp : "/tmp");
+	if (mkdtemp(dir) == NULL)
+		err(1, "%s", dir);
+	if (setenv("XDG_CACHE_HOME", dir, 1) == -1)
+		err(1, "setenv");
+
+	/* Search, play a mix and change tracks until the soak is done */
+	if (argc == 1)
+		(void)snprintf(script, sizeof(script), "%s", argv[0]);
+	else {
+		if (snprintf(script, sizeof(script), "%s/script", dir) >=
+		    (int)sizeof(script))
+			errx(1, "%s: path too long", dir);
+		fp = fopen(script, "w");
+		if (fp == NULL)
+			err(1, "%s", script);
+		(void)fprintf(fp, "key s\ntype tags:bench\nkey enter\n"
+		    "until search\nkey enter\nuntil play\nuntil next %d\n"
+		    "key q\n", tracks);
+		if (fclose(fp) == EOF)
+			err(1, "%s", script);
+	}
+
+	/* The stand-in API listens on a port of the loopback interface */
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1)
+		err(1, "socket");
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = 0;
+	len = sizeof(sin);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) == -1 ||
+	    listen(fd, 64) == -1 ||
+	    getsockname(fd, (struct sockaddr *)&sin, &len) == -1)
+		err(1, "listen");
+	port = ntohs(sin.sin_port);
+	(void)snprintf(api, sizeof(api), "http://127.0.0.1:%d/", port);
+	(void)signal(SIGPIPE, SIG_IGN);
+	server = fork();
+	if (server == -1)
+		err(1, "fork");
+	if (server == 0) {
+		serve(fd, port);
+		_exit(0);
+	}
+	(void)close(fd);
+
+	/* 8p prints the measurements when the script has ended */
+	n = 0;
+	args[n++] = prog;
+	args[n++] = "-r";
+	args[n++] = script;
+	args[n++] = "-A";
+	args[n++] = api;
+	if (output != NULL) {
+		args[n++] = "-o";
+		args[n++] = output;
+	}
+	args[n] = NULL;
+	if (pipe(pfd) == -1)
+		err(1, "pipe");
+	run = fork();
+	if (run == -1)
+		err(1, "fork");
+	if (run == 0) {
+		(void)close(pfd[0]);
+		if (dup2(pfd[1], STDOUT_FILENO) == -1)
+			err(127, "dup2");
+		(void)close(pfd[1]);
+		(void)alarm((unsigned)timeout);
+		(void)execvp(prog, (char *const *)args);
+		err(127, "%s", prog);
+	}
+	(void)close(pfd[1]);
+	fp = fdopen(pfd[0], "r");
+	if (fp == NULL)
+		err(1, "fdopen");
+	n = readphases(fp, cur, PHASES, stdout);
+	(void)fclose(fp);
+
+	failed = 0;
+	if (waitpid(run, &status, 0) == -1 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0) {
+		warnx("%s did not finish the scenario", prog);
+		failed = 1;
+	}
+	(void)kill(server, SIGTERM);
+	(void)waitpid(server, NULL, 0);
+	if (keep == 1)
+		(void)printf("# caches kept in %s\n", dir);
+	else
+		(void)nftw(dir, rm, 16, FTW_DEPTH | FTW_PHYS);
+
+	/* Per occurrence of each phase */
+	(void)printf("%-8s %6s", "phase", "count");
+	for (i = 0; i < METRICS; i++)
+		(void)printf(" %12s", names[i]);
+	(void)printf("\n");
+	for (i = 0; i < n; i++) {
+		(void)printf("%-8s %6d", cur[i].name, cur[i].count);
+		for (j = 0; j < METRICS; j++) {
+			if (cur[i].count == 0 || cur[i].sum[j] < 0)
+				(void)printf(" %12s", "-");
+			else
+				(void)printf(" %12.*f", j <= M_CPU ? 3 : 0,
+				    cur[i].sum[j] / cur[i].count /
+				    (j <= M_CPU ? 1e6 : 1));
+		}
+		(void)printf("\n");
+	}
+
+	if (basepath == NULL || failed == 1)
+		return failed;
+	if (save == 1) {
+		if (writephases(basepath, cur, n) == -1)
+			err(1, "%s", basepath);
+		return 0;
+	}
+	fp = fopen(basepath, "r");
+	if (fp == NULL)
+		err(1, "%s", basepath);
+	nbase = readphases(fp, base, PHASES, NULL);
+	(void)fclose(fp);
+
+	return compare(cur, n, base, nbase, threshold) > 0;
+}
+
+/* Print the phases that got slower than the baseline by more than
+ * threshold percent, returns their number.  Context switches are only
+ * shown, they vary too much between runs to fail one.
+ */
+static int
+compare(const struct phase *cur, int n, const struct phase *base,
+    int nbase, int threshold)
+{
+	double c, b;
+	int i, j, m, worse;
+
+	worse = 0;
+	for (j = 0; j < nbase; j++) {
+		if (base[j].count == 0)
+			continue;
+		for (i = 0; i < n; i++) {
+			if (strcmp(cur[i].name, base[j].name) == 0)
+				break;
+		}
+		if (i == n || cur[i].count == 0) {
+			(void)printf("%s: did not run\n", base[j].name);
+			worse++;
+			continue;
+		}
+		for (m = 0; m < METRICS; m++) {
+			if (m == M_CTXSW || cur[i].sum[m] < 0 ||
+			    base[j].sum[m] <= 0)
+				continue;
+			c = cur[i].sum[m] / cur[i].count;
+			b = base[j].sum[m] / base[j].count;
+			if (c <= b * (100 + threshold) / 100)
+				continue;
+			(void)printf("%s: %s %+.0f%% of the baseline\n",
+			    cur[i].name, names[m], (c - b) * 100 / b);
+			worse++;
+		}
+	}
+
+	return worse;
+}
+
+/* Little endian, as in WAV files */
+static void
+put32(unsigned char *p, unsigned long v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8 & 0xff;
+	p[2] = v >> 16 & 0xff;
+	p[3] = v >> 24 & 0xff;
+}
+
+/* Read the phase lines 8p prints, other lines starting with # are
+ * copied to echo.
+ */
+static int
+readphases(FILE *fp, struct phase *p, int max, FILE *echo)
+{
+	char line[512];
+	int n;
+
+	n = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (line[0] == '#' && echo != NULL)
+			(void)fputs(line, echo);
+		if (n == max || sscanf(line,
+		    "phase\t%31s\t%d\t%lf\t%lf\t%lf\t%lf\t%lf", p[n].name,
+		    &p[n].count, &p[n].sum[M_WALL], &p[n].sum[M_CPU],
+		    &p[n].sum[M_CTXSW], &p[n].sum[M_MISSES],
+		    &p[n].sum[M_INSTR]) != 2 + METRICS)
+			continue;
+		n++;
+	}
+
+	return n;
+}
+
+static void
+reply(int c, int head, const char *status, const char *type,
+    const char *body, size_t len)
+{
+	char hdr[256];
+	int n;
+
+	n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 %s\r\nContent-Type: %s\r\n"
+	    "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, type,
+	    len);
+	if (n < 0 || write(c, hdr, (size_t)n) != n)
+		return;
+	if (head == 0)
+		(void)write(c, body, len);
+}
+
+/* Answer one request of the stand-in API.  It has the endpoints 8p
+ * uses, with a play token of "bench", MIXES mixes per search and
+ * MIXTRACKS tracks per mix, each next mix following the last.
+ */
+static void
+respond(int c, int port)
+{
+	char req[4096], body[16384];
+	char method[8], path[2048];
+	const char *q;
+	size_t len;
+	ssize_t r;
+	int i, n, id, pos, last;
+
+	len = 0;
+	while (len < sizeof(req) - 1) {
+		r = read(c, req + len, sizeof(req) - 1 - len);
+		if (r <= 0)
+			break;
+		len += (size_t)r;
+		req[len] = '\0';
+		if (strstr(req, "\r\n\r\n") != NULL)
+			break;
+	}
+	req[len] = '\0';
+	if (sscanf(req, "%7s %2047s", method, path) != 2)
+		return;
+
+	q = strstr(path, "mix_id=");
+	id = q != NULL ? atoi(q + strlen("mix_id=")) : 0;
+	if (id < 0)
+		id = 0;
+	n = -1;
+	if (strncmp(path, "/audio/", strlen("/audio/")) == 0) {
+		reply(c, strcmp(method, "HEAD") == 0, "200 OK", "audio/wav",
+		    (const char *)audio, sizeof(audio));
+		return;
+	} else if (strncmp(path, "/sets/new", strlen("/sets/new")) == 0)
+		n = snprintf(body, sizeof(body), "{\"status\":\"200 OK\","
+		    "\"play_token\":\"bench\"}");
+	else if (strncmp(path, "/mix_sets/", strlen("/mix_sets/")) == 0 ||
+	    strstr(path, "/next_mix?") != NULL) {
+		n = snprintf(body, sizeof(body), "{\"status\":\"200 OK\",%s",
+		    id > 0 ? "\"next_mix\":" : "\"mix_set\":{\"mixes\":[");
+		for (i = 0; i < (id > 0 ? 1 : MIXES) && n > 0 &&
+		    (size_t)n < sizeof(body); i++)
+			n += snprintf(body + n, sizeof(body) - (size_t)n,
+			    "%s{\"id\":%d,\"name\":\"Bench mix %d\","
+			    "\"user_id\":%d,\"description\":\"Mix %d of the "
+			    "stand-in API.\\nIt has %d silent tracks.\","
+			    "\"likes_count\":%d,\"plays_count\":%d,"
+			    "\"tracks_count\":%d,\"tag_list_cache\":"
+			    "\"bench, silence, mix %d\","
+			    "\"liked_by_current_user\":false}",
+			    i > 0 ? "," : "", id + i + 1, id + i + 1,
+			    (id + i) % 5 + 1, id + i + 1, MIXTRACKS,
+			    (id + i) * 7, (id + i) * 31, MIXTRACKS,
+			    id + i + 1);
+		if (n > 0 && (size_t)n < sizeof(body))
+			n += snprintf(body + n, sizeof(body) - (size_t)n,
+			    "%s}", id > 0 ? "" : "],\"next_page\":null}");
+	} else if (strstr(path, "/play?") != NULL ||
+	    strstr(path, "/next?") != NULL) {
+		if (strstr(path, "/play?") != NULL)
+			position[id % MIXSLOTS] = 0;
+		pos = position[id % MIXSLOTS]++;
+		last = pos >= MIXTRACKS - 1;
+		n = snprintf(body, sizeof(body), "{\"status\":\"200 OK\","
+		    "\"set\":{\"at_last_track\":%s,\"skip_allowed\":true,"
+		    "\"track\":{\"id\":%d,\"name\":\"Track %d\","
+		    "\"performer\":\"Performer %d\","
+		    "\"track_file_stream_url\":"
+		    "\"http://127.0.0.1:%d/audio/%d.wav\"}}}",
+		    last ? "true" : "false", id * 100 + pos, pos + 1,
+		    id % 9 + 1, port, id * 100 + pos);
+	} else if (strstr(path, "/report?") != NULL)
+		n = snprintf(body, sizeof(body), "{\"status\":\"200 OK\"}");
+	else if (strncmp(path, "/users/", strlen("/users/")) == 0)
+		n = snprintf(body, sizeof(body), "{\"status\":\"200 OK\","
+		    "\"user\":{\"id\":%d,\"login\":\"dj%d\"}}",
+		    atoi(path + strlen("/users/")),
+		    atoi(path + strlen("/users/")));
+
+	if (n < 0 || (size_t)n >= sizeof(body))
+		reply(c, strcmp(method, "HEAD") == 0, "404 Not Found",
+		    "application/json", "{\"status\":\"404 Not Found\"}",
+		    strlen("{\"status\":\"404 Not Found\"}"));
+	else
+		reply(c, strcmp(method, "HEAD") == 0, "200 OK",
+		    "application/json", body, (size_t)n);
+}
+
+static int
+rm(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+	(void)st;
+	(void)flag;
+	(void)ftw;
+
+	return remove(path);
+}
+
+/* Answer requests one at a time until killed */
+static void
+serve(int fd, int port)
+{
+	int c;
+
+	wav();
+	for (;;) {
+		c = accept(fd, NULL, NULL);
+		if (c == -1)
+			continue;
+		respond(c, port);
+		(void)close(c);
+	}
+}
+
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "usage: 8pbench [-kw] [-b baseline] "
+	    "[-n tracks] [-o output] [-t percent]\n"
+	    "               [-T seconds] [-x 8p] [script]\n");
+	exit(1);
+}
+
+/* A WAV file of 8-bit mono samples at RATE */
+static void
+wav(void)
+{
+	(void)memcpy(audio, "RIFF", 4);
+	put32(audio + 4, 36 + RATE);
+	(void)memcpy(audio + 8, "WAVEfmt ", 8);
+	put32(audio + 16, 16);
+	put32(audio + 20, 1 | 1 << 16);		/* PCM, mono */
+	put32(audio + 24, RATE);
+	put32(audio + 28, RATE);		/* Bytes per second */
+	put32(audio + 32, 1 | 8 << 16);		/* Bytes, bits per sample */
+	(void)memcpy(audio + 36, "data", 4);
+	put32(audio + 40, RATE);
+	memset(audio + 44, 0x80, RATE);
+}
+
+static int
+writephases(const char *path, const struct phase *p, int n)
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen(path, "w");
+	if (fp == NULL)
+		return -1;
+	for (i = 0; i < n; i++)
+		(void)fprintf(fp, "phase\t%s\t%d\t%.0f\t%.0f\t%.0f\t%.0f\t"
+		    "%.0f\n", p[i].name, p[i].count, p[i].sum[M_WALL],
+		    p[i].sum[M_CPU], p[i].sum[M_CTXSW], p[i].sum[M_MISSES],
+		    p[i].sum[M_INSTR]);
+
+	return fclose(fp) == EOF ? -1 : 0;
+}
@@ -0,0 +1,104 @@
+/* See LICENSE file for copyright and license details. */
+
+/* 8pctl: send a command to 8p running in daemon mode */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void	sockpath(char *, size_t);
+static void	usage(void);
+
+int
+main(int argc, char *argv[])
+{
+	struct sockaddr_un sun;
+	char buf[4096];
+	ssize_t n;
+	int ch, fd, i, ok;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	sun.sun_path[0] = '\0';
+	while ((ch = getopt(argc, argv, "s:")) != -1) {
+		switch (ch) {
+		case 's':
+			if (strlen(optarg) >= sizeof(sun.sun_path))
+				errx(1, "socket path too long");
+			(void)memcpy(sun.sun_path, optarg, strlen(optarg) + 1);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0)
+		usage();
+	if (sun.sun_path[0] == '\0')
+		sockpath(sun.sun_path, sizeof(sun.sun_path));
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		err(1, "socket");
+	if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == -1)
+		err(1, "%s", sun.sun_path);
+
+	/* The arguments form one command line */
+	for (i = 0; i < argc; i++) {
+		if ((i > 0 && write(fd, " ", 1) != 1) ||
+		    write(fd, argv[i], strlen(argv[i])) !=
+		    (ssize_t)strlen(argv[i]))
+			err(1, "write");
+	}
+	if (write(fd, "\n", 1) != 1)
+		err(1, "write");
+	(void)shutdown(fd, SHUT_WR);
+
+	/* 8p closes the connection when it reads the end of the commands,
+	 * which the shutdown above sends, after replying to them
+	 */
+	ok = -1;
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		if (ok == -1)
+			ok = n >= 2 && strncmp(buf, "OK", 2) == 0;
+		(void)fwrite(buf, 1, (size_t)n, stdout);
+	}
+	(void)close(fd);
+
+	return ok == 1 ? 0 : 1;
+}
+
+/* Same default as 8p -d */
+static void
+sockpath(char *path, size_t len)
+{
+	const char *dir;
+
+	dir = getenv("XDG_RUNTIME_DIR");
+	if (dir != NULL && *dir != '\0') {
+		(void)snprintf(path, len, "%s/8p.sock", dir);
+		return;
+	}
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir != NULL && *dir != '\0') {
+		(void)snprintf(path, len, "%s/8p/control", dir);
+		return;
+	}
+	dir = getenv("HOME");
+	if (dir == NULL)
+		errx(1, "no path for the control socket");
+	(void)snprintf(path, len, "%s/.cache/8p/control", dir);
+}
+
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "usage: 8pctl [-s socket] command "
+	    "[argument]\n");
+	exit(1);
+}
@@ -0,0 +1,85 @@
+/* See LICENSE file for copyright and license details. */
+
+/* 8pstatus: print the now playing status that 8p exports */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "status.h"
+
+static void	readstatus(const struct status *, struct status *);
+
+int
+main(int argc, char *argv[])
+{
+	const char *state[] = {"start", "search", "searching", "select",
+	    "play"};
+	struct status *shm, st;
+	char name[64];
+	void *p;
+	int fd;
+
+	(void)argv;
+	if (argc != 1) {
+		(void)fprintf(stderr, "usage: 8pstatus\n");
+		return 1;
+	}
+
+	(void)snprintf(name, sizeof(name), STATUSNAME, (unsigned)getuid());
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1)
+		errx(1, "8p is not running");
+	p = mmap(NULL, sizeof(struct status), PROT_READ, MAP_SHARED, fd, 0);
+	(void)close(fd);
+	if (p == MAP_FAILED)
+		err(1, "mmap");
+	shm = (struct status *)p;
+	if (shm->version != STATUSVERSION)
+		errx(1, "unknown status version %u", shm->version);
+	readstatus(shm, &st);
+
+	(void)printf("state: %s\n", st.state >= 0 && st.state <= PLAY ?
+	    state[st.state] : "unknown");
+	(void)printf("online: %s\n", st.online ? "yes" : "no");
+	if (st.state == PLAY) {
+		(void)printf("mix: %d %s\n", st.mix_id, st.mix_name);
+		(void)printf("track: %d %s - %s\n", st.track_id, st.performer,
+		    st.track_name);
+		(void)printf("position: %lld:%02lld / %lld:%02lld%s\n",
+		    (long long)st.position / 60000,
+		    (long long)st.position / 1000 % 60,
+		    (long long)st.length / 60000,
+		    (long long)st.length / 1000 % 60,
+		    st.paused ? " (paused)" : "");
+	}
+	if (st.buffering >= 0)
+		(void)printf("buffering: %d%%\n", st.buffering);
+	if (st.error[0] != '\0')
+		(void)printf("error: %s\n", st.error);
+	(void)printf("updated: %llu\n", (unsigned long long)st.updated);
+	(void)munmap(p, sizeof(struct status));
+
+	return 0;
+}
+
+/* Copy the status without a torn read, see struct status */
+static void
+readstatus(const struct status *shm, struct status *st)
+{
+	uint32_t seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		memcpy(st, shm, sizeof(struct status));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+			break;
+	}
+	st->error[sizeof(st->error) - 1] = '\0';
+	st->mix_name[sizeof(st->mix_name) - 1] = '\0';
+	st->performer[sizeof(st->performer) - 1] = '\0';
+	st->track_name[sizeof(st->track_name) - 1] = '\0';
+}
@@ -0,0 +1,272 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "api.h"
+
+static int	api_append(char *, size_t, size_t *, const char *, int);
+static int	api_expand(char *, size_t, const char *,
+		    const struct apiargs *, int);
+static int	api_smartid(char *, size_t, const char *);
+static int	api_termcmp(const void *, const void *);
+
+/* The 8tracks API.  Urls and store keys are formats in which %t is the
+ * play token, %s the smart id, %m the mix id, %k the track id, %n the
+ * track number, %p the page and %u the user id.  An url that needs the
+ * play token is not requested without one, only the stored response is
+ * used then.  field is the member of the response returned by
+ * api_get().
+ */
+static const struct endpoint {
+	const char	*url;
+	const char	*key;
+	const char	*field;
+} endpoints[API_MAX] = {
+	{ "sets/new",
+	    NULL,			"play_token" },
+	{ "sets/%t/play?mix_id=%m",
+	    "set/%m/%n",		"set" },
+	{ "sets/%t/next?mix_id=%m",
+	    "set/%m/%n",		"set" },
+	{ "sets/%t/next_mix?mix_id=%m&include=mixes[liked]&smart_id=%s",
+	    "next_mix/%m/%s",		"next_mix" },
+	{ "mix_sets/%s?include=mixes[liked]",
+	    "mix_sets/%s",		"mix_set" },
+	{ "mix_sets/%s?include=mixes[liked]&page=%p",
+	    "mix_sets/%s/%p",		"mix_set" },
+	{ "sets/%t/report?track_id=%k&mix_id=%m",
+	    NULL,			NULL },
+	{ "users/%u",
+	    "users/%u",			"user" }
+};
+
+/* Request an endpoint, or use its stored response.  Returns the parsed
+ * response, which the caller releases, and sets obj to its field.
+ */
+json_t *
+api_get(int ep, const struct apiargs *a, json_t **obj)
+{
+	char url[APIURL], key[APIURL];
+	char *js;
+	int errn, hasurl, haskey;
+	json_t *root, *status;
+
+	hasurl = api_expand(url, sizeof(url), endpoints[ep].url, a, TRUE);
+	haskey = endpoints[ep].key != NULL &&
+	    api_expand(key, sizeof(key), endpoints[ep].key, a, FALSE) ==
+	    SUCCESS;
+	root = NULL;
+
+	js = malloc(1);
+	if (js == NULL)
+		err(1, NULL);
+	if (haskey == TRUE)
+		errn = fetch_stored(&js, hasurl == SUCCESS ? url : NULL, key);
+	else if (hasurl == SUCCESS)
+		errn = fetch(&js, url);
+	else
+		errn = ERROR;
+	if (errn == ERROR)
+		goto error;
+
+	root = json_loads(js, 0, NULL);
+	if (root == NULL)
+		goto error;
+	status = json_object_get(root, "status");
+	if (!json_is_string(status) ||
+	    strcmp(json_string_value(status), "200 OK") != 0)
+		goto error;
+	*obj = json_object_get(root, endpoints[ep].field);
+	if (*obj == NULL)
+		goto error;
+	if (haskey == TRUE)
+		(void)store_put(key, js);
+	free(js);
+
+	return root;
+
+error:
+	free(js);
+	if (root)
+		json_decref(root);
+
+	return NULL;
+}
+
+/* The store key of a request */
+int
+api_key(int ep, const struct apiargs *a, char *key, size_t size)
+{
+	if (endpoints[ep].key == NULL)
+		return ERROR;
+
+	return api_expand(key, size, endpoints[ep].key, a, FALSE);
+}
+
+/* Request an endpoint of which the response does not matter */
+int
+api_send(int ep, const struct apiargs *a)
+{
+	char url[APIURL];
+	char *js;
+	int errn;
+
+	if (api_expand(url, sizeof(url), endpoints[ep].url, a, TRUE) ==
+	    ERROR)
+		return ERROR;
+	js = malloc(1);
+	if (js == NULL)
+		err(1, NULL);
+	errn = fetch(&js, url);
+	free(js);
+
+	return errn;
+}
+
+/* Append s at *len, percent-encoded in urls.  The smart id syntax, ':'
+ * and '+', is left as it is.
+ */
+static int
+api_append(char *buf, size_t size, size_t *len, const char *s,
+    int encode)
+{
+	const char hex[] = "0123456789ABCDEF";
+	unsigned char c;
+
+	for (; *s != '\0'; s++) {
+		c = (unsigned char)*s;
+		if (encode == FALSE || isalnum(c) || strchr("-._~:+", c) !=
+		    NULL) {
+			if (*len + 1 >= size)
+				return ERROR;
+			buf[(*len)++] = (char)c;
+		} else {
+			if (*len + 3 >= size)
+				return ERROR;
+			buf[(*len)++] = '%';
+			buf[(*len)++] = hex[c >> 4];
+			buf[(*len)++] = hex[c & 0xf];
+		}
+	}
+	buf[*len] = '\0';
+
+	return SUCCESS;
+}
+
+/* Expand an url or key format into buf, urls start with the API base */
+static int
+api_expand(char *buf, size_t size, const char *fmt,
+    const struct apiargs *a, int isurl)
+{
+	char num[16], smart_id[APIURL];
+	const char *s;
+	size_t len;
+
+	len = 0;
+	buf[0] = '\0';
+	if (isurl == TRUE &&
+	    api_append(buf, size, &len, fetch_base(), FALSE) == ERROR)
+		return ERROR;
+	for (; *fmt != '\0'; fmt++) {
+		if (*fmt != '%') {
+			if (len + 1 >= size)
+				return ERROR;
+			buf[len++] = *fmt;
+			buf[len] = '\0';
+			continue;
+		}
+		s = num;
+		switch (*++fmt) {
+		case 't':
+			s = a->token;
+			break;
+		case 's':
+			if (a->smart_id == NULL || api_smartid(smart_id,
+			    sizeof(smart_id), a->smart_id) == ERROR)
+				return ERROR;
+			s = smart_id;
+			break;
+		case 'm':
+			(void)snprintf(num, sizeof(num), "%d", a->mix_id);
+			break;
+		case 'k':
+			(void)snprintf(num, sizeof(num), "%d", a->track_id);
+			break;
+		case 'n':
+			(void)snprintf(num, sizeof(num), "%d", a->n);
+			break;
+		case 'p':
+			(void)snprintf(num, sizeof(num), "%d", a->page);
+			break;
+		case 'u':
+			(void)snprintf(num, sizeof(num), "%d", a->user_id);
+			break;
+		default:
+			return ERROR;
+		}
+		if (s == NULL ||
+		    api_append(buf, size, &len, s, isurl) == ERROR)
+			return ERROR;
+	}
+
+	return SUCCESS;
+}
+
+/* Smart ids that name the same mixes are requested and stored the same
+ * way: the tags of tags:B+a are trimmed, lowercased and sorted into
+ * tags:a+b.
+ */
+static int
+api_smartid(char *buf, size_t size, const char *id)
+{
+	char tags[APIURL];
+	char *term[APITAGS];
+	char *last, *p, *e;
+	size_t len;
+	int i, n;
+
+	if (strncmp(id, "tags:", strlen("tags:")) != 0) {
+		if (strlcpy(buf, id, size) >= size)
+			return ERROR;
+		return SUCCESS;
+	}
+
+	if (strlcpy(tags, id + strlen("tags:"), sizeof(tags)) >=
+	    sizeof(tags))
+		return ERROR;
+	for (p = tags; *p != '\0'; p++)
+		*p = (char)tolower((unsigned char)*p);
+	n = 0;
+	for (p = strtok_r(tags, "+", &last); p != NULL;
+	    p = strtok_r(NULL, "+", &last)) {
+		while (*p == ' ')
+			p++;
+		for (e = p + strlen(p); e > p && e[-1] == ' '; e--)
+			e[-1] = '\0';
+		if (*p == '\0')
+			continue;
+		if (n == APITAGS)
+			return ERROR;
+		term[n++] = p;
+	}
+	qsort(term, (size_t)n, sizeof(term[0]), api_termcmp);
+
+	len = 0;
+	buf[0] = '\0';
+	if (api_append(buf, size, &len, "tags:", FALSE) == ERROR)
+		return ERROR;
+	for (i = 0; i < n; i++) {
+		if (i > 0 && strcmp(term[i], term[i - 1]) == 0)
+			continue;
+		if ((i > 0 && api_append(buf, size, &len, "+", FALSE) ==
+		    ERROR) || api_append(buf, size, &len, term[i], FALSE) ==
+		    ERROR)
+			return ERROR;
+	}
+
+	return SUCCESS;
+}
+
+static int
+api_termcmp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
@@ -0,0 +1,33 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef API_H
+#define API_H
+
+#include <ctype.h>
+#include <jansson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "fetch.h"
+#include "store.h"
+
+enum apiendpoints {API_NEWSET, API_PLAY, API_NEXT, API_NEXTMIX,
+    API_MIXSET, API_MIXSETPAGE, API_REPORT, API_USER, API_MAX};
+
+/* Parameters of a request, each endpoint uses some of them */
+struct apiargs {
+	const char	*token;
+	const char	*smart_id;
+	int		 mix_id;
+	int		 track_id;
+	int		 n;		/* Track number in the mix */
+	int		 page;
+	int		 user_id;
+};
+
+json_t	*api_get(int, const struct apiargs *, json_t **);
+int	 api_key(int, const struct apiargs *, char *, size_t);
+int	 api_send(int, const struct apiargs *);
+
+#endif
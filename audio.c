@@ -0,0 +1,121 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "audio.h"
+
+static int	null_init(struct info *);
+static void	null_exit(struct info *);
+static void	null_pause(struct info *);
+static int	null_play(struct info *, struct track *);
+static void	null_position(struct info *, long long *, long long *,
+		    int *);
+static int	null_state(struct info *);
+static void	null_stop(struct info *);
+
+/* The null sink plays nothing.  Its clock advances NULLSTEP each time
+ * the state is polled, which play_ended() does once per iteration of
+ * the main loop, so a run takes the same course for the same input
+ * without a sound card.
+ */
+const struct audio audio_null = {
+	"null",
+	null_init,
+	null_exit,
+	null_play,
+	null_stop,
+	null_pause,
+	null_position,
+	null_state
+};
+
+/* Look up a backend by the argument of -o.  The file sink takes the
+ * directory to write to after a colon, it is returned in arg.  The
+ * directory is quoted inside a VLC :sout chain, so characters that
+ * would end the quote or the chain are refused.
+ */
+const struct audio *
+audio_find(const char *spec, const char **arg)
+{
+	*arg = NULL;
+	if (strcmp(spec, "vlc") == 0)
+		return &audio_vlc;
+	if (strcmp(spec, "null") == 0)
+		return &audio_null;
+	if (strncmp(spec, "file:", strlen("file:")) == 0 &&
+	    spec[strlen("file:")] != '\0' &&
+	    strpbrk(spec + strlen("file:"), "'\"\\{}:,#") == NULL) {
+		*arg = spec + strlen("file:");
+		return &audio_file;
+	}
+
+	return NULL;
+}
+
+static int
+null_init(struct info *data)
+{
+	struct info *z;
+
+	for (z = data; z != NULL; z = z->zone_next) {
+		z->sink_state = AUDIO_IDLE;
+		z->audio_status = SUCCESS;
+	}
+
+	return SUCCESS;
+}
+
+static void
+null_exit(struct info *data)
+{
+	data->sink_state = AUDIO_IDLE;
+}
+
+static void
+null_pause(struct info *data)
+{
+	if (data->sink_state == AUDIO_PLAYING)
+		data->sink_state = AUDIO_PAUSED;
+	else if (data->sink_state == AUDIO_PAUSED)
+		data->sink_state = AUDIO_PLAYING;
+}
+
+static int
+null_play(struct info *data, struct track *t)
+{
+	(void)t;
+
+	data->sink_time = 0;
+	data->sink_length = NULLLENGTH;
+	data->sink_state = AUDIO_PLAYING;
+
+	return SUCCESS;
+}
+
+static void
+null_position(struct info *data, long long *time, long long *length,
+    int *paused)
+{
+	*time = data->sink_time;
+	*length = data->sink_state == AUDIO_IDLE ? 0 : data->sink_length;
+	*paused = data->sink_state == AUDIO_PAUSED ? TRUE : FALSE;
+}
+
+static int
+null_state(struct info *data)
+{
+	if (data->sink_state == AUDIO_PLAYING) {
+		data->sink_time += NULLSTEP;
+		if (data->sink_time >= data->sink_length) {
+			data->sink_time = data->sink_length;
+			data->sink_state = AUDIO_ENDED;
+		}
+	}
+
+	return data->sink_state;
+}
+
+static void
+null_stop(struct info *data)
+{
+	data->sink_time = 0;
+	data->sink_state = AUDIO_IDLE;
+}
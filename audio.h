@@ -0,0 +1,34 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <string.h>
+#include "defs.h"
+#include "mix.h"
+
+enum audiostates {AUDIO_IDLE, AUDIO_PLAYING, AUDIO_PAUSED, AUDIO_ENDED};
+
+/* An audio backend.  init() runs on a background thread and sets up
+ * every zone linked from the first, the other functions act on a
+ * single zone once it is set up.  Times are in milliseconds.
+ */
+struct audio {
+	const char	*name;
+	int		(*init)(struct info *);
+	void		(*exit)(struct info *);
+	int		(*play)(struct info *, struct track *);
+	void		(*stop)(struct info *);
+	void		(*pause)(struct info *);
+	void		(*position)(struct info *, long long *, long long *,
+			    int *);
+	int		(*state)(struct info *);
+};
+
+extern const struct audio	audio_file;
+extern const struct audio	audio_null;
+extern const struct audio	audio_vlc;
+
+const struct audio	*audio_find(const char *, const char **);
+
+#endif
@@ -0,0 +1,108 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "batch.h"
+
+static void	batch_print(struct mix *, int);
+static void	batch_setstr(json_t *, const char *, const char *);
+
+/* Print the mixes of a smart id without the terminal interface, each
+ * mix as soon as it is parsed.  With next, the chain of mixes that
+ * follow mix next is printed instead of the search results.  count
+ * limits the number of mixes and pages the number of search pages,
+ * zero means no limit.
+ */
+int
+batch_run(struct info *data, const char *smart_id, int next, int json,
+    int count, int pages)
+{
+	json_t *root, *mix_set, *mixes, *np;
+	struct mix *m;
+	size_t i, n;
+	int page, printed;
+
+	printed = 0;
+	if (next != 0) {
+		if (setplaytoken(data) == ERROR && fetch_online() == TRUE)
+			return ERROR;
+		if (count == 0)
+			count = 1;
+		for (; printed < count; printed++) {
+			m = search_fetchnextmix(data->playtoken, next,
+			    smart_id);
+			if (m == NULL)
+				break;
+			batch_print(m, json);
+			next = m->id;
+			mix_free(m);
+		}
+		return printed > 0 ? SUCCESS : ERROR;
+	}
+
+	for (page = 1; pages == 0 || page <= pages; page++) {
+		root = search_fetchpage(smart_id, page);
+		if (root == NULL)
+			break;
+		mix_set = json_object_get(root, "mix_set");
+		mixes = json_object_get(mix_set, "mixes");
+		n = json_is_array(mixes) ? json_array_size(mixes) : 0;
+		for (i = 0; i < n && (count == 0 || printed < count); i++) {
+			m = mix_create(json_array_get(mixes, i));
+			if (m == NULL)
+				continue;
+			batch_print(m, json);
+			mix_free(m);
+			printed++;
+		}
+
+		/* Stop at the last page */
+		np = json_object_get(mix_set, "next_page");
+		json_decref(root);
+		if (n == 0 || np == NULL || json_is_null(np) ||
+		    (count > 0 && printed >= count))
+			break;
+	}
+
+	return printed > 0 ? SUCCESS : ERROR;
+}
+
+static void
+batch_print(struct mix *m, int json)
+{
+	json_t *obj;
+	char *s;
+
+	if (json == FALSE) {
+		(void)printf("%d\t%s\n", m->id, m->name != NULL ? m->name : "");
+		(void)fflush(stdout);
+		return;
+	}
+
+	obj = json_object();
+	if (obj == NULL)
+		err(1, NULL);
+	(void)json_object_set_new(obj, "id", json_integer(m->id));
+	batch_setstr(obj, "name", m->name);
+	(void)json_object_set_new(obj, "user_id", json_integer(m->user_id));
+	batch_setstr(obj, "description", m->description);
+	batch_setstr(obj, "tags", m->tags);
+	(void)json_object_set_new(obj, "plays_count",
+	    json_integer(m->plays_count));
+	(void)json_object_set_new(obj, "likes_count",
+	    json_integer(m->likes_count));
+	(void)json_object_set_new(obj, "liked",
+	    m->liked == TRUE ? json_true() : json_false());
+	s = json_dumps(obj, JSON_COMPACT);
+	json_decref(obj);
+	if (s == NULL)
+		err(1, NULL);
+	(void)printf("%s\n", s);
+	(void)fflush(stdout);
+	free(s);
+}
+
+static void
+batch_setstr(json_t *obj, const char *key, const char *value)
+{
+	(void)json_object_set_new(obj, key, value != NULL ?
+	    json_string(value) : json_null());
+}
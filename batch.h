@@ -0,0 +1,18 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <err.h>
+#include <jansson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "defs.h"
+#include "fetch.h"
+#include "mix.h"
+#include "search.h"
+#include "util.h"
+
+int	batch_run(struct info *, const char *, int, int, int, int);
+
+#endif
@@ -0,0 +1,199 @@
+/* See LICENSE file for copyright and license details. */
+
+#define _DEFAULT_SOURCE		/* syscall() */
+
+#include "bench.h"
+
+static int	bench_open(uint32_t, uint64_t);
+static void	bench_read(struct benchsample *);
+
+/* Phases are measured in wall time, CPU time of the process and, where
+ * perf_event_open() is allowed, context switches, cache misses and
+ * instructions.  A counter covers the main thread and the threads
+ * created after it was opened, so bench_init() runs before 8p creates
+ * any.  The startup phase runs from bench_start() at the top of main(),
+ * its counters from bench_init().  Only the main thread begins and ends
+ * phases.
+ */
+static const char *names[BENCH_MAX] = {"startup", "search", "play",
+    "next", "soak"};
+
+static struct {
+	int			enabled;
+	int			fd[BC_MAX];
+	uint64_t		wall0;		/* Of bench_start() */
+	uint64_t		cpu0;
+	struct {
+		int			running;
+		int			count;
+		struct benchsample	start;
+		struct benchsample	sum;
+	} phase[BENCH_MAX];
+} bench;
+
+void
+bench_begin(int p)
+{
+	if (bench.enabled == FALSE || bench.phase[p].running == TRUE)
+		return;
+	bench_read(&bench.phase[p].start);
+	bench.phase[p].running = TRUE;
+}
+
+/* Times phase p ended */
+int
+bench_count(int p)
+{
+	return bench.phase[p].count;
+}
+
+void
+bench_end(int p)
+{
+	struct benchsample now;
+	int i;
+
+	if (bench.enabled == FALSE || bench.phase[p].running == FALSE)
+		return;
+	bench_read(&now);
+	bench.phase[p].sum.wall += now.wall - bench.phase[p].start.wall;
+	bench.phase[p].sum.cpu += now.cpu - bench.phase[p].start.cpu;
+	for (i = 0; i < BC_MAX; i++) {
+		if (now.c[i] == -1 || bench.phase[p].sum.c[i] == -1)
+			bench.phase[p].sum.c[i] = -1;
+		else
+			bench.phase[p].sum.c[i] += now.c[i] -
+			    bench.phase[p].start.c[i];
+	}
+	bench.phase[p].count++;
+	bench.phase[p].running = FALSE;
+}
+
+/* The phase of a name, or -1 */
+int
+bench_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX; i++) {
+		if (strcmp(name, names[i]) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Open the counters and begin the startup phase */
+void
+bench_init(void)
+{
+#ifdef __linux__
+	bench.fd[BC_CTXSW] = bench_open(PERF_TYPE_SOFTWARE,
+	    PERF_COUNT_SW_CONTEXT_SWITCHES);
+	bench.fd[BC_MISSES] = bench_open(PERF_TYPE_HARDWARE,
+	    PERF_COUNT_HW_CACHE_MISSES);
+	bench.fd[BC_INSTR] = bench_open(PERF_TYPE_HARDWARE,
+	    PERF_COUNT_HW_INSTRUCTIONS);
+#else
+	bench.fd[BC_CTXSW] = bench.fd[BC_MISSES] = bench.fd[BC_INSTR] = -1;
+#endif
+	bench.enabled = TRUE;
+	bench_begin(BENCH_STARTUP);
+	if (bench.wall0 != 0) {
+		bench.phase[BENCH_STARTUP].start.wall = bench.wall0;
+		bench.phase[BENCH_STARTUP].start.cpu = bench.cpu0;
+	}
+}
+
+/* Print a line per phase: name, count and the sums of wall and CPU
+ * nanoseconds, context switches, cache misses and instructions.
+ * Phases still running end here.
+ */
+void
+bench_print(FILE *fp)
+{
+	int i;
+
+	if (bench.enabled == FALSE)
+		return;
+	for (i = 0; i < BENCH_MAX; i++) {
+		bench_end(i);
+		(void)fprintf(fp, "phase\t%s\t%d\t%llu\t%llu\t%lld\t%lld\t"
+		    "%lld\n", names[i], bench.phase[i].count,
+		    (unsigned long long)bench.phase[i].sum.wall,
+		    (unsigned long long)bench.phase[i].sum.cpu,
+		    (long long)bench.phase[i].sum.c[BC_CTXSW],
+		    (long long)bench.phase[i].sum.c[BC_MISSES],
+		    (long long)bench.phase[i].sum.c[BC_INSTR]);
+	}
+}
+
+int
+bench_running(int p)
+{
+	return bench.phase[p].running;
+}
+
+/* Note when 8p starts, before it knows whether it is benchmarked */
+void
+bench_start(void)
+{
+	struct timespec ts;
+
+	bench.wall0 = monotime();
+	(void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	bench.cpu0 = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Open a counter of the calling thread and the threads it creates from
+ * now on, which add to it while they run and after they exit.  Hardware
+ * counters only count user space, which perf_event_paranoid allows
+ * unprivileged processes.
+ */
+static int
+bench_open(uint32_t type, uint64_t config)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	long fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.inherit = 1;
+	attr.exclude_hv = 1;
+	attr.exclude_kernel = type == PERF_TYPE_HARDWARE;
+	fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+	    PERF_FLAG_FD_CLOEXEC);
+
+	return fd < 0 || fd > INT_MAX ? -1 : (int)fd;
+#else
+	(void)type;
+	(void)config;
+
+	return -1;
+#endif
+}
+
+/* Context switches fall back to getrusage() */
+static void
+bench_read(struct benchsample *s)
+{
+	struct timespec ts;
+	struct rusage ru;
+	uint64_t v;
+	int i;
+
+	s->wall = monotime();
+	(void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	s->cpu = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+	for (i = 0; i < BC_MAX; i++) {
+		s->c[i] = -1;
+		if (bench.fd[i] != -1 && read(bench.fd[i], &v, sizeof(v)) ==
+		    (ssize_t)sizeof(v))
+			s->c[i] = (int64_t)v;
+	}
+	if (s->c[BC_CTXSW] == -1 && getrusage(RUSAGE_SELF, &ru) == 0)
+		s->c[BC_CTXSW] = ru.ru_nvcsw + ru.ru_nivcsw;
+}
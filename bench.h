@@ -0,0 +1,48 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+#include "defs.h"
+#include "util.h"
+
+/* Phases of a scenario, each runs from a begin to an end */
+enum benchphases {
+	BENCH_STARTUP,	/* Start to the first frame */
+	BENCH_SEARCH,	/* Enter to the results on screen */
+	BENCH_PLAY,	/* Selecting a mix to its first audio */
+	BENCH_NEXT,	/* End of a track to the audio of the next */
+	BENCH_SOAK,	/* First audio to the end of the run */
+	BENCH_MAX
+};
+
+enum benchcounters {BC_CTXSW, BC_MISSES, BC_INSTR, BC_MAX};
+
+struct benchsample {
+	uint64_t	wall;
+	uint64_t	cpu;
+	int64_t		c[BC_MAX];	/* -1 when not available */
+};
+
+void	bench_begin(int);
+int	bench_count(int);
+void	bench_end(int);
+int	bench_find(const char *);
+void	bench_init(void);
+void	bench_print(FILE *);
+int	bench_running(int);
+void	bench_start(void);
+
+#endif
@@ -0,0 +1,259 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "cache.h"
+
+static void	cache_evict(uint64_t);
+static int	cache_find(int);
+static void	cache_insert(int, uint64_t, time_t);
+
+/* Tracks are cached on disk as files named by their track id.  The
+ * modification time of a file is its last use, which orders the entries
+ * for LRU eviction.  The cache is shared by all streams, so its state
+ * is guarded by cache_lock.
+ */
+static pthread_mutex_t	 cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static char		 cache_dir[PATH_MAX];
+static int		 cache_enabled = FALSE;
+static uint64_t		 cache_max = 0;
+static uint64_t		 cache_size = 0;
+static struct cache_entry {
+	int		 id;
+	uint64_t	 size;
+	time_t		 used;
+}			*cache_list = NULL;
+static size_t		 cache_count = 0;
+static struct cachestats cache_st;
+
+int
+cache_init(uint64_t max)
+{
+	DIR *dir;
+	struct dirent *de;
+	struct stat sb;
+	char path[PATH_MAX];
+	char *ep;
+	long id;
+	int n;
+
+	memset(&cache_st, 0, sizeof(cache_st));
+	if (max == 0)
+		return SUCCESS;
+	if (datadir(cache_dir, sizeof(cache_dir), "audio") == ERROR)
+		return ERROR;
+	dir = opendir(cache_dir);
+	if (dir == NULL)
+		return ERROR;
+
+	/* Index the cached tracks, partial downloads left behind by an
+	 * earlier run are removed.
+	 */
+	while ((de = readdir(dir)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 ||
+		    strcmp(de->d_name, "..") == 0)
+			continue;
+		n = snprintf(path, sizeof(path), "%s/%s", cache_dir,
+		    de->d_name);
+		if (n < 0 || (size_t)n >= sizeof(path))
+			continue;
+		id = strtol(de->d_name, &ep, 10);
+		if (*ep != '\0' || id <= 0) {
+			(void)unlink(path);
+			continue;
+		}
+		if (stat(path, &sb) == -1 || !S_ISREG(sb.st_mode))
+			continue;
+		cache_insert((int)id, (uint64_t)sb.st_size, sb.st_mtime);
+	}
+	(void)closedir(dir);
+
+	cache_max = max;
+	cache_enabled = TRUE;
+	cache_evict(0);
+
+	return SUCCESS;
+}
+
+void
+cache_exit(void)
+{
+	(void)pthread_mutex_lock(&cache_lock);
+	free(cache_list);
+	cache_list = NULL;
+	cache_count = 0;
+	cache_size = 0;
+	cache_enabled = FALSE;
+	(void)pthread_mutex_unlock(&cache_lock);
+}
+
+/* Check for a track without counting it as a hit or miss */
+int
+cache_has(int id)
+{
+	int found;
+
+	(void)pthread_mutex_lock(&cache_lock);
+	found = cache_enabled == TRUE && cache_find(id) != -1 ? TRUE : FALSE;
+	(void)pthread_mutex_unlock(&cache_lock);
+
+	return found;
+}
+
+/* Look up a track, on a hit path is set to the cached file */
+int
+cache_lookup(int id, char *path, size_t len)
+{
+	int i;
+
+	(void)pthread_mutex_lock(&cache_lock);
+	if (cache_enabled == FALSE) {
+		(void)pthread_mutex_unlock(&cache_lock);
+		return FALSE;
+	}
+	i = cache_find(id);
+	if (i == -1) {
+		cache_st.misses++;
+		(void)pthread_mutex_unlock(&cache_lock);
+		return FALSE;
+	}
+	(void)snprintf(path, len, "%s/%d", cache_dir, id);
+
+	/* Mark the entry as most recently used */
+	cache_list[i].used = time(NULL);
+	(void)utimensat(AT_FDCWD, path, NULL, 0);
+
+	cache_st.hits++;
+	cache_st.saved += cache_list[i].size;
+	(void)pthread_mutex_unlock(&cache_lock);
+
+	return TRUE;
+}
+
+/* Open a temporary file to store a track while it is downloaded */
+FILE *
+cache_begin(int id, char *path, size_t len)
+{
+	FILE *fp;
+	int fd, n;
+
+	if (cache_enabled == FALSE || id <= 0)
+		return NULL;
+
+	n = snprintf(path, len, "%s/.%d.XXXXXX", cache_dir, id);
+	if (n < 0 || (size_t)n >= len)
+		return NULL;
+	fd = mkstemp(path);
+	if (fd == -1)
+		return NULL;
+	fp = fdopen(fd, "wb");
+	if (fp == NULL) {
+		(void)close(fd);
+		(void)unlink(path);
+	}
+
+	return fp;
+}
+
+void
+cache_abort(FILE *fp, const char *path)
+{
+	if (fp == NULL)
+		return;
+	(void)fclose(fp);
+	(void)unlink(path);
+}
+
+/* Move a completely downloaded track into the cache */
+void
+cache_commit(int id, FILE *fp, const char *path)
+{
+	char dst[PATH_MAX];
+	struct stat sb;
+	int n;
+
+	if (fp == NULL)
+		return;
+	if (fclose(fp) != 0 || stat(path, &sb) == -1) {
+		(void)unlink(path);
+		return;
+	}
+
+	(void)pthread_mutex_lock(&cache_lock);
+	if (cache_enabled == FALSE || (uint64_t)sb.st_size > cache_max ||
+	    cache_find(id) != -1) {
+		(void)pthread_mutex_unlock(&cache_lock);
+		(void)unlink(path);
+		return;
+	}
+	cache_evict((uint64_t)sb.st_size);
+	n = snprintf(dst, sizeof(dst), "%s/%d", cache_dir, id);
+	if (n < 0 || (size_t)n >= sizeof(dst) || rename(path, dst) == -1) {
+		(void)pthread_mutex_unlock(&cache_lock);
+		(void)unlink(path);
+		return;
+	}
+	cache_insert(id, (uint64_t)sb.st_size, time(NULL));
+	cache_st.stored += (uint64_t)sb.st_size;
+	(void)pthread_mutex_unlock(&cache_lock);
+}
+
+void
+cache_stats(struct cachestats *st)
+{
+	(void)pthread_mutex_lock(&cache_lock);
+	*st = cache_st;
+	st->size = cache_size;
+	st->count = cache_count;
+	(void)pthread_mutex_unlock(&cache_lock);
+}
+
+/* Remove the least recently used tracks until there is room for len
+ * more bytes.  Called with cache_lock held.
+ */
+static void
+cache_evict(uint64_t len)
+{
+	char path[PATH_MAX];
+	size_t i, lru;
+	int n;
+
+	while (cache_count > 0 && cache_size + len > cache_max) {
+		for (i = 1, lru = 0; i < cache_count; i++) {
+			if (cache_list[i].used < cache_list[lru].used)
+				lru = i;
+		}
+		n = snprintf(path, sizeof(path), "%s/%d", cache_dir,
+		    cache_list[lru].id);
+		if (n >= 0 && (size_t)n < sizeof(path))
+			(void)unlink(path);
+		cache_size -= cache_list[lru].size;
+		cache_st.evicted++;
+		cache_list[lru] = cache_list[--cache_count];
+	}
+}
+
+static int
+cache_find(int id)
+{
+	size_t i;
+
+	for (i = 0; i < cache_count; i++) {
+		if (cache_list[i].id == id)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+static void
+cache_insert(int id, uint64_t size, time_t used)
+{
+	cache_list = realloc(cache_list,
+	    (cache_count + 1) * sizeof(struct cache_entry));
+	if (cache_list == NULL)
+		err(1, NULL);
+	cache_list[cache_count].id = id;
+	cache_list[cache_count].size = size;
+	cache_list[cache_count].used = used;
+	cache_count++;
+	cache_size += size;
+}
@@ -0,0 +1,40 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "defs.h"
+#include "util.h"
+
+struct cachestats {
+	uint64_t	 hits;
+	uint64_t	 misses;
+	uint64_t	 saved;		/* Bytes not downloaded due to hits */
+	uint64_t	 stored;	/* Bytes added to the cache */
+	uint64_t	 evicted;	/* Tracks removed to make room */
+	uint64_t	 size;		/* Bytes in the cache */
+	size_t		 count;		/* Tracks in the cache */
+};
+
+void	 cache_abort(FILE *, const char *);
+FILE	*cache_begin(int, char *, size_t);
+void	 cache_commit(int, FILE *, const char *);
+void	 cache_exit(void);
+int	 cache_has(int);
+int	 cache_init(uint64_t);
+int	 cache_lookup(int, char *, size_t);
+void	 cache_stats(struct cachestats *);
+
+#endif
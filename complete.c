@@ -0,0 +1,294 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "complete.h"
+
+static void	complete_find(uint32_t, char *, size_t, char (*)[COMPLETELEN],
+		    uint32_t *, int *, int);
+static void	complete_insert(const char *, uint32_t);
+static uint32_t	complete_node(uint32_t, unsigned char, int);
+
+/* Completions of smart ids are kept in a trie of bytes.  The children
+ * of a node are a list sorted by byte, and every node knows the highest
+ * count below it, so the most frequent completions of a prefix are
+ * found without visiting the subtrees that cannot hold them.  The nodes
+ * are one array, written to disk as it is.
+ */
+struct cnode {
+	uint32_t	 child;		/* First child, 0 if none */
+	uint32_t	 next;		/* Next sibling, 0 if none */
+	uint32_t	 count;		/* Times seen, 0 if no entry ends */
+	uint32_t	 best;		/* Highest count of the subtree */
+	unsigned char	 c;
+};
+struct chdr {
+	char		 magic[4];
+	uint32_t	 version;
+	uint32_t	 nnodes;
+};
+
+/* Prefixes of smart ids, always ranked first */
+static const char	*prefixes[] = {"all:", "artist:", "dj:", "keyword:",
+			    "liked:", "local:", "similar:", "tags:"};
+
+static pthread_mutex_t	 complete_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct cnode	*nodes = NULL;
+static uint32_t		 nnodes = 0;
+static uint32_t		 cap = 0;
+static int		 dirty = FALSE;
+static char		 complete_path[PATH_MAX];
+
+/* Count a value seen for a smart id type, e.g. ("tags", "Hip Hop") */
+void
+complete_add(const char *type, const char *value)
+{
+	char key[COMPLETELEN];
+	size_t len, i;
+
+	if (value == NULL)
+		return;
+	while (*value == ' ')
+		value++;
+	len = strlen(value);
+	while (len > 0 && value[len - 1] == ' ')
+		len--;
+	i = strlen(type) + 1;
+	if (len == 0 || i + len >= sizeof(key))
+		return;
+
+	/* Smart ids have no spaces and are case insensitive */
+	(void)snprintf(key, sizeof(key), "%s:", type);
+	for (; len > 0; len--, value++) {
+		if (*value == '+' || *value == ':')
+			return;
+		key[i++] = *value == ' ' ? '_' : tolower((unsigned char)*value);
+	}
+	key[i] = '\0';
+
+	(void)pthread_mutex_lock(&complete_lock);
+	if (nodes != NULL)
+		complete_insert(key, 0);
+	(void)pthread_mutex_unlock(&complete_lock);
+}
+
+void
+complete_exit(void)
+{
+	char tmp[PATH_MAX];
+	struct chdr hdr;
+	FILE *fp;
+	int n;
+
+	(void)pthread_mutex_lock(&complete_lock);
+	n = snprintf(tmp, sizeof(tmp), "%s.tmp", complete_path);
+	if (dirty == TRUE && n >= 0 && (size_t)n < sizeof(tmp)) {
+		(void)memcpy(hdr.magic, COMPLETEMAGIC, sizeof(hdr.magic));
+		hdr.version = COMPLETEVERSION;
+		hdr.nnodes = nnodes;
+		fp = fopen(tmp, "wb");
+		if (fp != NULL) {
+			if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+			    fwrite(nodes, sizeof(struct cnode), nnodes, fp) !=
+			    nnodes || fclose(fp) == EOF ||
+			    rename(tmp, complete_path) == -1)
+				(void)unlink(tmp);
+		}
+	}
+	free(nodes);
+	nodes = NULL;
+	nnodes = 0;
+	cap = 0;
+	(void)pthread_mutex_unlock(&complete_lock);
+}
+
+int
+complete_init(void)
+{
+	struct chdr hdr;
+	FILE *fp;
+	uint32_t i;
+	size_t j;
+
+	if (datadir(complete_path, sizeof(complete_path), "complete") ==
+	    ERROR)
+		return ERROR;
+	if (strlcat(complete_path, "/trie", sizeof(complete_path)) >=
+	    sizeof(complete_path))
+		return ERROR;
+
+	(void)pthread_mutex_lock(&complete_lock);
+	fp = fopen(complete_path, "rb");
+	if (fp != NULL) {
+		if (fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+		    memcmp(hdr.magic, COMPLETEMAGIC, sizeof(hdr.magic)) == 0 &&
+		    hdr.version == COMPLETEVERSION && hdr.nnodes > 0 &&
+		    hdr.nnodes <= COMPLETENODES) {
+			nodes = malloc(hdr.nnodes * sizeof(struct cnode));
+			if (nodes == NULL)
+				err(1, NULL);
+			cap = hdr.nnodes;
+			if (fread(nodes, sizeof(struct cnode), hdr.nnodes,
+			    fp) == hdr.nnodes)
+				nnodes = hdr.nnodes;
+		}
+		(void)fclose(fp);
+	}
+
+	/* Links out of the array mean the file is damaged */
+	for (i = 0; i < nnodes; i++) {
+		if (nodes[i].child >= nnodes || nodes[i].next >= nnodes) {
+			nnodes = 0;
+			break;
+		}
+	}
+	if (nnodes == 0) {
+		free(nodes);
+		nodes = calloc(1, sizeof(struct cnode));
+		if (nodes == NULL)
+			err(1, NULL);
+		nnodes = 1;
+		cap = 1;
+	}
+
+	for (j = 0; j < sizeof(prefixes) / sizeof(prefixes[0]); j++)
+		complete_insert(prefixes[j], UINT32_MAX / 2);
+	dirty = FALSE;
+	(void)pthread_mutex_unlock(&complete_lock);
+
+	return SUCCESS;
+}
+
+/* Find up to max of the most frequent entries starting with prefix,
+ * most frequent first.  Returns their number.
+ */
+int
+complete_lookup(const char *prefix, char (*out)[COMPLETELEN], int max)
+{
+	char key[COMPLETELEN];
+	uint32_t counts[COMPLETESHOW];
+	uint32_t n;
+	size_t len;
+	int found;
+
+	if (max > COMPLETESHOW)
+		max = COMPLETESHOW;
+	len = strlen(prefix);
+	if (max <= 0 || len == 0 || len >= sizeof(key))
+		return 0;
+	for (len = 0; prefix[len] != '\0'; len++)
+		key[len] = tolower((unsigned char)prefix[len]);
+	key[len] = '\0';
+
+	found = 0;
+	(void)pthread_mutex_lock(&complete_lock);
+	if (nodes == NULL)
+		goto done;
+	for (n = 0, len = 0; key[len] != '\0' && n != UINT32_MAX; len++)
+		n = complete_node(n, (unsigned char)key[len], FALSE);
+	if (n != UINT32_MAX && nodes[n].child != 0)
+		complete_find(nodes[n].child, key, len, out, counts, &found,
+		    max);
+done:
+	(void)pthread_mutex_unlock(&complete_lock);
+
+	return found;
+}
+
+/* Collect the entries below node n into the ranking of out, skipping
+ * subtrees that have no count higher than the last one ranked.
+ */
+static void
+complete_find(uint32_t n, char *key, size_t len, char (*out)[COMPLETELEN],
+    uint32_t *counts, int *found, int max)
+{
+	int i;
+
+	if (len + 1 >= COMPLETELEN)
+		return;
+	for (; n != 0; n = nodes[n].next) {
+		if (*found == max && nodes[n].best <= counts[max - 1])
+			continue;
+		key[len] = (char)nodes[n].c;
+		if (nodes[n].count > 0 &&
+		    (*found < max || nodes[n].count > counts[max - 1])) {
+			i = *found < max ? (*found)++ : max - 1;
+			for (; i > 0 && counts[i - 1] < nodes[n].count; i--) {
+				counts[i] = counts[i - 1];
+				(void)memcpy(out[i], out[i - 1], COMPLETELEN);
+			}
+			counts[i] = nodes[n].count;
+			(void)memcpy(out[i], key, len + 1);
+			out[i][len + 1] = '\0';
+		}
+		if (nodes[n].child != 0)
+			complete_find(nodes[n].child, key, len + 1, out, counts,
+			    found, max);
+	}
+}
+
+/* Count key once more, or at least weight times */
+static void
+complete_insert(const char *key, uint32_t weight)
+{
+	uint32_t path[COMPLETELEN];
+	uint32_t n, count;
+	size_t len, i;
+
+	len = strlen(key);
+	if (len == 0 || len >= COMPLETELEN)
+		return;
+	for (n = 0, i = 0; i < len; i++) {
+		path[i] = n;
+		n = complete_node(n, (unsigned char)key[i], TRUE);
+		if (n == UINT32_MAX)
+			return;		/* The trie is full */
+	}
+
+	count = nodes[n].count;
+	if (weight > 0)
+		count = count > weight ? count : weight;
+	else if (count < UINT32_MAX / 2 - 1)
+		count++;
+	nodes[n].count = count;
+	if (nodes[n].best < count)
+		nodes[n].best = count;
+	for (i = 0; i < len; i++) {
+		if (nodes[path[i]].best < count)
+			nodes[path[i]].best = count;
+	}
+	dirty = TRUE;
+}
+
+/* The child of n for byte c, added if create is TRUE.  Returns
+ * UINT32_MAX if there is none.
+ */
+static uint32_t
+complete_node(uint32_t n, unsigned char c, int create)
+{
+	uint32_t *link, new;
+
+	for (link = &nodes[n].child; *link != 0 && nodes[*link].c < c;
+	    link = &nodes[*link].next)
+		;
+	if (*link != 0 && nodes[*link].c == c)
+		return *link;
+	if (create == FALSE || nnodes == COMPLETENODES)
+		return UINT32_MAX;
+
+	if (nnodes == cap) {
+		/* The link moves with the array */
+		new = (uint32_t)((unsigned char *)link -
+		    (unsigned char *)nodes);
+		cap = cap * 2 < COMPLETENODES ? cap * 2 : COMPLETENODES;
+		nodes = realloc(nodes, cap * sizeof(struct cnode));
+		if (nodes == NULL)
+			err(1, NULL);
+		link = (uint32_t *)((unsigned char *)nodes + new);
+	}
+	new = nnodes++;
+	memset(&nodes[new], 0, sizeof(struct cnode));
+	nodes[new].c = c;
+	nodes[new].next = *link;
+	*link = new;
+
+	return new;
+}
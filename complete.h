@@ -0,0 +1,27 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#include <bsd/string.h>
+#include <ctype.h>
+#include <err.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "defs.h"
+#include "util.h"
+
+#define COMPLETEMAGIC	"8pac"
+#define COMPLETEVERSION	1
+
+void	 complete_add(const char *, const char *);
+void	 complete_exit(void);
+int	 complete_init(void);
+int	 complete_lookup(const char *, char (*)[COMPLETELEN], int);
+
+#endif
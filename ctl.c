@@ -0,0 +1,398 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "ctl.h"
+
+static void	ctl_accept(void);
+static void	ctl_clean(char *, size_t, const char *);
+static void	ctl_close(int);
+static void	ctl_command(struct info *, int, char *);
+static void	ctl_list(struct info *, int);
+static int	ctl_read(struct info *, int);
+static void	ctl_reply(int, const char *, ...);
+static void	ctl_search(struct info *, const char *);
+static void	ctl_stats(struct info *, int);
+static void	ctl_status(struct info *, int);
+
+/* In daemon mode 8p is controlled through a UNIX domain socket.  A
+ * client sends one command per line and gets a line starting with "OK"
+ * or "ERR" back, "list" follows its "OK" with one line per mix.
+ * A command may start with a zone number, it defaults to zone 1.
+ * Replies are sent without blocking, a client that does not read them
+ * is disconnected.  Commands run on the main thread: a search waits for
+ * its first page, holding up the other clients and zones meanwhile.
+ */
+static int		 ctl_fd = -1;
+static char		 ctl_sockpath[PATH_MAX];
+static struct ctlclient {
+	int		 fd;
+	size_t		 len;
+	char		 buf[CTLLINE];
+}			 ctl_clients[CTLCLIENTS];
+
+void
+ctl_exit(void)
+{
+	int i;
+
+	for (i = 0; i < CTLCLIENTS; i++)
+		ctl_close(i);
+	if (ctl_fd == -1)
+		return;
+	(void)close(ctl_fd);
+	(void)unlink(ctl_sockpath);
+	ctl_fd = -1;
+}
+
+/* Wait for commands, waking up in time for the main loop checks */
+void
+ctl_handle(struct info *data)
+{
+	struct pollfd pfd[CTLCLIENTS + 1];
+	struct info *z;
+	int client[CTLCLIENTS + 1];
+	int delay, i, n;
+
+	delay = prefetch_timeout(data);
+	for (z = data->zone_next; z != NULL; z = z->zone_next) {
+		if (prefetch_timeout(z) < delay)
+			delay = prefetch_timeout(z);
+	}
+	n = 0;
+	pfd[n].fd = ctl_fd;
+	pfd[n].events = POLLIN;
+	client[n++] = -1;
+	for (i = 0; i < CTLCLIENTS; i++) {
+		if (ctl_clients[i].fd == -1)
+			continue;
+		pfd[n].fd = ctl_clients[i].fd;
+		pfd[n].events = POLLIN;
+		client[n++] = i;
+	}
+	if (poll(pfd, (nfds_t)n, delay) <= 0)
+		return;
+
+	for (i = 1; i < n; i++) {
+		if (pfd[i].revents != 0 && ctl_read(data, client[i]) == ERROR)
+			ctl_close(client[i]);
+	}
+	if (pfd[0].revents & POLLIN)
+		ctl_accept();
+}
+
+/* Listen on path, a stale socket of an earlier run is replaced */
+int
+ctl_init(const char *path)
+{
+	struct sockaddr_un sun;
+	int i;
+
+	for (i = 0; i < CTLCLIENTS; i++)
+		ctl_clients[i].fd = -1;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlcpy(sun.sun_path, path, sizeof(sun.sun_path)) >=
+	    sizeof(sun.sun_path))
+		return ERROR;
+	(void)strlcpy(ctl_sockpath, path, sizeof(ctl_sockpath));
+
+	ctl_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ctl_fd == -1)
+		return ERROR;
+	(void)unlink(path);
+	if (bind(ctl_fd, (struct sockaddr *)&sun, sizeof(sun)) == -1 ||
+	    listen(ctl_fd, CTLCLIENTS) == -1) {
+		(void)close(ctl_fd);
+		ctl_fd = -1;
+		return ERROR;
+	}
+	(void)fcntl(ctl_fd, F_SETFL, O_NONBLOCK);
+
+	return SUCCESS;
+}
+
+/* The default socket, in $XDG_RUNTIME_DIR or else the data directory */
+int
+ctl_path(char *path, size_t len)
+{
+	const char *dir;
+	int n;
+
+	dir = getenv("XDG_RUNTIME_DIR");
+	if (dir != NULL && *dir != '\0') {
+		n = snprintf(path, len, "%s/8p.sock", dir);
+		return n < 0 || (size_t)n >= len ? ERROR : SUCCESS;
+	}
+	if (datadir(path, len, "") == ERROR)
+		return ERROR;
+	if (strlcat(path, "control", len) >= len)
+		return ERROR;
+
+	return SUCCESS;
+}
+
+static void
+ctl_accept(void)
+{
+	int fd, i;
+
+	fd = accept(ctl_fd, NULL, NULL);
+	if (fd == -1)
+		return;
+	for (i = 0; i < CTLCLIENTS; i++) {
+		if (ctl_clients[i].fd == -1)
+			break;
+	}
+	if (i == CTLCLIENTS) {
+		ctl_reply(fd, "ERR too many clients");
+		(void)close(fd);
+		return;
+	}
+	(void)fcntl(fd, F_SETFL, O_NONBLOCK);
+	ctl_clients[i].fd = fd;
+	ctl_clients[i].len = 0;
+}
+
+static void
+ctl_close(int i)
+{
+	if (ctl_clients[i].fd == -1)
+		return;
+	(void)close(ctl_clients[i].fd);
+	ctl_clients[i].fd = -1;
+}
+
+/* Replace tabs and line breaks, which separate fields and replies */
+static void
+ctl_clean(char *dst, size_t len, const char *src)
+{
+	size_t i;
+
+	if (src == NULL)
+		src = "";
+	for (i = 0; i + 1 < len && src[i] != '\0'; i++)
+		dst[i] = src[i] == '\t' || src[i] == '\n' || src[i] == '\r' ?
+		    ' ' : src[i];
+	dst[i] = '\0';
+}
+
+static void
+ctl_command(struct info *zones, int fd, char *line)
+{
+	struct info *data;
+	char *arg, *ep;
+	struct notice *n;
+	long pos;
+
+	/* Pick the zone */
+	data = zones;
+	pos = strtol(line, &ep, 10);
+	if (ep != line && (*ep == ' ' || *ep == '\0')) {
+		while (data != NULL && data->zone != pos)
+			data = data->zone_next;
+		if (data == NULL) {
+			ctl_reply(fd, "ERR no such zone");
+			return;
+		}
+		line = *ep == ' ' ? ep + 1 : ep;
+	}
+
+	arg = strchr(line, ' ');
+	if (arg != NULL)
+		*arg++ = '\0';
+
+	/* Nobody sees the notifications, they become the reply */
+	data->notice_count = 0;
+
+	if (strcmp(line, "status") == 0) {
+		ctl_status(data, fd);
+		return;
+	} else if (strcmp(line, "stats") == 0) {
+		ctl_stats(data, fd);
+		return;
+	} else if (strcmp(line, "list") == 0) {
+		ctl_list(data, fd);
+		return;
+	} else if (strcmp(line, "search") == 0)
+		ctl_search(data, arg != NULL ? arg : "");
+	else if (strcmp(line, "select") == 0) {
+		pos = arg != NULL ? strtol(arg, NULL, 10) : 0;
+		if (data->state != SELECT || pos < 1 ||
+		    pos > (long)data->mlist_size ||
+		    data->mlist[pos - 1] == NULL) {
+			ctl_reply(fd, "ERR no such mix");
+			return;
+		}
+		data->select_pos = (int)pos - 1;
+		select_select(data);
+	} else if (strcmp(line, "back") == 0 && data->state == SELECT)
+		select_exit(data);
+	else if (strcmp(line, "next") == 0 && data->state == PLAY)
+		play_skip(data);
+	else if (strcmp(line, "pause") == 0 && data->state == PLAY)
+		play_togglepause(data);
+	else if (strcmp(line, "nextmix") == 0 && data->state == PLAY)
+		play_nextmix(data);
+	else if (strcmp(line, "quit") == 0)
+		zones->quit = TRUE;	/* Stops every zone */
+	else {
+		ctl_reply(fd, "ERR unknown command");
+		return;
+	}
+
+	n = notify_current(data);
+	if (n != NULL)
+		ctl_reply(fd, "ERR %s", n->msg);
+	else
+		ctl_reply(fd, "OK");
+	data->notice_count = 0;
+}
+
+static void
+ctl_list(struct info *data, int fd)
+{
+	char name[CTLLINE];
+	size_t i;
+
+	if (data->state != SELECT || data->mlist == NULL) {
+		ctl_reply(fd, "ERR no search results");
+		return;
+	}
+	ctl_reply(fd, "OK %zu", data->mlist_size);
+	for (i = 0; i < data->mlist_size; i++) {
+		if (data->mlist[i] == NULL) {
+			ctl_reply(fd, "%zu\t0\t", i + 1);
+			continue;
+		}
+		ctl_clean(name, sizeof(name), data->mlist[i]->name);
+		ctl_reply(fd, "%zu\t%d\t%s", i + 1, data->mlist[i]->id, name);
+	}
+}
+
+/* Handle the complete lines a client sent, ERROR closes the client */
+static int
+ctl_read(struct info *data, int i)
+{
+	struct ctlclient *c;
+	char *nl;
+	ssize_t n;
+	size_t len;
+
+	c = &ctl_clients[i];
+	n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len - 1);
+	if (n == -1 && (errno == EAGAIN || errno == EINTR))
+		return SUCCESS;
+	if (n <= 0)
+		return ERROR;
+	c->len += (size_t)n;
+	c->buf[c->len] = '\0';
+
+	while ((nl = strchr(c->buf, '\n')) != NULL) {
+		*nl = '\0';
+		if (nl > c->buf && nl[-1] == '\r')
+			nl[-1] = '\0';
+		ctl_command(data, c->fd, c->buf);
+		len = c->len - (size_t)(nl + 1 - c->buf);
+		memmove(c->buf, nl + 1, len + 1);
+		c->len = len;
+	}
+	if (c->len == sizeof(c->buf) - 1) {
+		ctl_reply(c->fd, "ERR line too long");
+		return ERROR;
+	}
+
+	return SUCCESS;
+}
+
+static void
+ctl_reply(int fd, const char *fmt, ...)
+{
+	char buf[CTLLINE + 32];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	if ((size_t)len > sizeof(buf) - 2)
+		len = sizeof(buf) - 2;
+	buf[len++] = '\n';
+
+	/* A short write leaves the reply cut, the read side sees it */
+	(void)send(fd, buf, (size_t)len, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/* Run a search like typing the smart id in the search view */
+static void
+ctl_search(struct info *data, const char *smart_id)
+{
+	wchar_t wc;
+	mbstate_t ps;
+	size_t n;
+
+	if (data->state == SELECT)
+		select_exit(data);
+	search_init(data);
+	memset(&ps, 0, sizeof(ps));
+	while (*smart_id != '\0') {
+		n = mbrtowc(&wc, smart_id, strlen(smart_id), &ps);
+		if (n == (size_t)-1 || n == (size_t)-2)
+			break;
+		search_addchar(data, (wint_t)wc);
+		smart_id += n;
+	}
+	search_search(data);
+}
+
+static void
+ctl_stats(struct info *data, int fd)
+{
+	struct zonestats st;
+	struct localstats ls;
+
+	play_stats(data, &st);
+	local_stats(&ls);
+	ctl_reply(fd, "OK\tzone=%d\tdevice=%s\tuptime=%llu\ttracks=%llu\t"
+	    "bytes=%llu\tstalls=%llu\tindex_docs=%llu\tindex_bytes=%llu\t"
+	    "index_queries=%llu\tindex_query_us=%llu", data->zone,
+	    data->zone_device != NULL ? data->zone_device : "default",
+	    (unsigned long long)((monotime() - data->start) / 1000000000),
+	    (unsigned long long)st.tracks, (unsigned long long)st.bytes,
+	    (unsigned long long)st.stalls, (unsigned long long)ls.docs,
+	    (unsigned long long)ls.bytes, (unsigned long long)ls.queries,
+	    (unsigned long long)(ls.query_time / 1000));
+}
+
+static void
+ctl_status(struct info *data, int fd)
+{
+	const char *state[] = {"start", "search", "searching", "select",
+	    "play"};
+	char mix[CTLLINE / 2], track[CTLLINE / 2];
+	struct track *t;
+	long long time, length;
+	int paused;
+
+	mix[0] = '\0';
+	track[0] = '\0';
+	t = NULL;
+	if (data->state == PLAY && data->m != NULL) {
+		ctl_clean(mix, sizeof(mix), data->m->name);
+		if (data->m->track_count > 0)
+			t = data->m->track[data->m->track_count - 1];
+		if (t != NULL) {
+			(void)snprintf(track, sizeof(track), "%s - %s",
+			    t->performer, t->name);
+			ctl_clean(track, sizeof(track), track);
+		}
+	}
+	play_position(data, &time, &length, &paused);
+
+	ctl_reply(fd, "OK\tzone=%d\tstate=%s\tonline=%d\tmix=%d\ttrack=%d\t"
+	    "time=%lld\tlength=%lld\tpaused=%d\tmix_name=%s\ttrack_name=%s",
+	    data->zone, state[data->state], fetch_online(),
+	    data->state == PLAY && data->m != NULL ? data->m->id : 0,
+	    t != NULL ? t->id : 0, time, length, paused, mix, track);
+}
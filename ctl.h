@@ -0,0 +1,34 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef CTL_H
+#define CTL_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <bsd/string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "defs.h"
+#include "fetch.h"
+#include "local.h"
+#include "notify.h"
+#include "play.h"
+#include "prefetch.h"
+#include "search.h"
+#include "select.h"
+#include "util.h"
+
+void	ctl_exit(void);
+void	ctl_handle(struct info *);
+int	ctl_init(const char *);
+int	ctl_path(char *, size_t);
+
+#endif
@@ -3,18 +3,110 @@
 #ifndef DEFS_H
 #define DEFS_H
 
+#include <pthread.h>
+#include <stdint.h>
 #include <vlc/vlc.h>
 
 #define APIKEY	"e233c13d38d96e3a3a0474723f6b3fcd21904979"
+#define APIBASE	"http://8tracks.com/"
+#define APIURL	1024	/* Longest request url or store key */
+#define APITAGS	32	/* Tags of a smart id */
 
 #define ERROR	0
 #define SUCCESS	1
 #define FALSE	0
 #define	TRUE	1
 
-#define HALFDELAY	50
+#define HALFDELAY	50	/* Input timeout in tenths of a second */
 #define DELAYESC	10
 
+#define STREAMBUF	4096	/* Read-ahead buffer per stream in KiB */
+#define STREAMSTALL	30	/* Seconds without bytes before a stream
+				 * download is given up */
+#define STREAMRETRIES	5	/* Failed transfers in a row before a
+				 * stream ends in an error */
+#define STREAMRETRY	1	/* Seconds before the first retry, doubled
+				 * for every further one */
+#define CACHESIZE	512	/* Disk cache for tracks in MiB */
+
+#define OFFLINEFAILS	3	/* Failed requests before going offline */
+#define OFFLINEPROBE	30	/* Seconds between checks for the network */
+#define REPORTRETRY	30	/* Seconds before a failed report is sent
+				 * again, doubled per failure in a row */
+#define REPORTRETRYMAX	3600
+#define REPORTTRIES	8	/* Failures before a report is dropped */
+#define FETCHSHAPE	256	/* KiB/s of bulk downloads while interactive
+				 * requests are in flight */
+
+#define NETLOGSIZE	256	/* Recent requests kept for the network log */
+#define NETLOGBUCKETS	25	/* Latency histogram buckets, up to ~16 s */
+
+#define TRACESIZE	2048	/* Trace events kept per thread */
+#define TRACETHREADS	16	/* Threads with a trace ring */
+
+#define PREFETCHDWELL	400	/* Milliseconds the cursor rests on a mix */
+#define FILTERLEN	64	/* Characters of the select view filter */
+#define COMPLETELEN	128	/* Bytes of a smart id completion */
+#define COMPLETESHOW	5	/* Completions shown while searching */
+#define COMPLETENODES	(1 << 21) /* Nodes of the completion trie */
+#define ENRICHJOBS	4	/* DJ name lookups at the same time */
+#define ENRICHCACHE	1024	/* DJ names kept */
+#define ENRICHNAME	64	/* Bytes of a DJ name */
+#define ENRICHTTL	3600	/* Seconds a DJ name is kept */
+#define ENRICHRETRY	60	/* Seconds before a failed lookup is retried */
+#define ENRICHPOLL	100	/* Milliseconds between checks for names */
+#define LOCALDELTA	256	/* Mixes indexed before rewriting the index */
+#define LOCALRESULTS	200	/* Mixes of a local search */
+
+#define HUDROWS		3	/* Rows taken by the performance HUD */
+#define HUDINTERVAL	1000	/* Milliseconds between HUD updates */
+
+#define CTLCLIENTS	8	/* Control socket connections */
+#define CTLLINE		512	/* Longest control command */
+#define ZONEMAX		8	/* Playback zones of a daemon */
+
+#define REPLAYLINES	24	/* Default size of the replay screen */
+#define REPLAYCOLS	80
+
+#define NULLLENGTH	180000	/* Milliseconds of a null sink track */
+#define NULLSTEP	1000	/* Null sink milliseconds per state poll */
+
+#define NOTIFYMAX	4	/* Queued footer messages */
+#define NOTIFYTIME	3000	/* Milliseconds a message is shown */
+
+/* Orders of the select view */
+enum sorts {SORT_SERVER, SORT_PLAYS, SORT_LIKES, SORT_NAME, SORT_TRACKS,
+    SORT_MAX};
+
+/* Startup phases, recorded in nanoseconds since the start of main() */
+enum phases {PHASE_LOCALE, PHASE_DRAW, PHASE_FRAME, PHASE_NET, PHASE_VLC,
+    PHASE_MAX};
+
+struct audio;
+struct replay;
+
+struct prefetch {
+	pthread_t	 thread;
+	pthread_mutex_t	 lock;
+	int		 running;	/* Thread started and not joined */
+	int		 done;		/* Set by the thread, under lock */
+	int		 mix_id;
+	int		 withtrack;	/* Also fetch the first track */
+	char		*smart_id;
+	struct mix	*m;
+	struct track	*t;
+	struct info	*data;
+};
+struct zonestats {
+	uint64_t	 tracks;	/* Tracks started */
+	uint64_t	 bytes;		/* Bytes streamed */
+	uint64_t	 stalls;	/* Reads that found the buffer empty */
+};
+struct notice {
+	char		 msg[128];
+	int		 count;		/* Coalesced repeats */
+	uint64_t	 expire;
+};
 struct info {
 	/*
 	 * Main section
@@ -23,12 +115,42 @@ struct info {
 	int	 state;
 	int	 pstate; /* Previous state */
 
+	/*
+	 * Startup section
+	 */
+	uint64_t	 start;
+	uint64_t	 phase[PHASE_MAX];
+	int		 timings;	/* Print phase timings on exit */
+	int		 headless;	/* Daemon mode, without ncurses */
+	int		 vlc_full;	/* Load the complete VLC module set */
+
 	/*
 	 * Play section
 	 */
 	char			*playtoken;
-	libvlc_instance_t	*vlc_inst;
+	pthread_mutex_t		 token_lock;
+	pthread_cond_t		 token_cond;
+	int			 token_busy;	/* A thread is fetching it */
+	pthread_t		 token_thread;
+	int			 token_pending;
+	int			 reports_queued;
+	int			 reports_failed; /* Failures in a row */
+	uint64_t		 reports_retry;	/* No sending before it */
+	const struct audio	*audio;		/* Output backend */
+	const char		*audio_arg;	/* File sink directory */
+	pthread_t		 audio_thread;
+	int			 audio_pending;	/* audio_thread not joined */
+	int			 audio_status;
+	libvlc_instance_t	*vlc_inst;	/* VLC and file sinks */
 	libvlc_media_player_t	*vlc_mp;
+	long long		 sink_time;	/* Null sink clock */
+	long long		 sink_length;
+	int			 sink_state;
+	struct prefetch		 pf_mix;	/* Mix following data->m */
+	struct stream		*stream;
+	size_t			 stream_size;	/* 0 lets VLC stream */
+	int			 stream_mmap;
+	uint64_t		 cache_size;	/* 0 disables the disk cache */
 	struct	 		mix *m;
 	
 	/*
@@ -36,7 +158,16 @@ struct info {
 	 */
 	struct	 mix **mlist;
 	size_t	 mlist_size;
-	int	 select_pos;
+	int	*view;		/* Indices into mlist as shown */
+	size_t	 view_size;
+	int	 select_pos;	/* Index into view */
+	int	 sort;
+	int	 filtering;	/* Keys go to the filter */
+	wchar_t	 filter[FILTERLEN + 1];
+	int	 filter_len;
+	uint64_t	 select_time;	/* When the cursor last moved */
+	struct prefetch	 pf_track;	/* First track of the mix under
+					 * the cursor */
 
 	/*
 	 * Search section
@@ -44,11 +175,52 @@ struct info {
 	int	 cursor_pos;
 	char	*search_str;
 	struct	 search_node *slist_head;
+	char	 suggest[COMPLETESHOW][COMPLETELEN];	/* Completions */
+	int	 suggest_count;
+	size_t	 suggest_skip;	/* Bytes typed of the completions */
+	unsigned int	 enrich_seen;	/* DJ name lookups drawn */
+
+	/*
+	 * Notification section
+	 */
+	struct notice	 notice[NOTIFYMAX];
+	int		 notice_count;
+
+	/*
+	 * Zone section, the zones of a process are linked from the first
+	 */
+	int		 zone;		/* Number, from 1 */
+	const char	*zone_device;	/* Audio output device or NULL */
+	struct info	*zone_next;
+	struct info	*vlc_shared;	/* First zone, which sets up audio */
+	struct zonestats zone_st;
+
+	/*
+	 * HUD section
+	 */
+	int		 hud;		/* Show the performance HUD */
+	uint64_t	 hud_next;	/* Time of the next update */
+	uint64_t	 hud_frametime;	/* Last full redraw in ns */
+	uint64_t	 hud_redraws;	/* Counted since the last update */
+	uint64_t	 hud_wakeups;
+	uint64_t	 hud_redrawrate;	/* Per second */
+	uint64_t	 hud_wakeuprate;
+	uint64_t	 hud_heap;	/* KiB in use */
+	uint64_t	 hud_bytes;	/* Stream bytes at the last update */
+	uint64_t	 hud_bitrate;	/* kbit/s */
 
 	/* 
 	 * Drawing section 
 	 */
 	int	 scroll;
+	int	 dirty;		/* Everything has to be drawn again */
+	struct replay	*replay;	/* Keys come from a script */
+};
+struct text {
+	wchar_t		*s;	/* Display form */
+	unsigned char	*meta;	/* TEXT_* of each character */
+	size_t		 len;
+	int		 width;	/* Columns of the whole text */
 };
 struct mix {
 	int	 id;
@@ -57,9 +229,15 @@ struct mix {
 	char	*description;
 	int	 likes_count;
 	int	 plays_count;
+	int	 tracks_count;
 	char	*tags;
+	char	*key;		/* Folded name, tags and description */
+	struct text	 name_text;	/* Display forms */
+	struct text	 description_text;
+	struct text	 tags_text;
 	int	 liked;
 	int	 finished;
+	int	 position;	/* Index of the next track response */
 	int	 track_count;
 	struct	 track **track;
 };
@@ -67,6 +245,7 @@ struct track {
 	int	 id;
 	char	*name;
 	char	*performer;
+	struct text	 title;	/* Display form of performer - name */
 	char	*url;
 	int	 last;
 	int	 reported;
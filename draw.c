@@ -10,38 +10,72 @@ static void	drawsearching(void);
 static void	drawselect(struct info *);
 static void	drawplay(struct info *);
 static void	drawfooter(struct info *);
+static void	drawbar(int);
 static void	drawbodyfill(int);
+static void	drawchrome(void);
+static void	drawrule(int, int);
+static void	drawclip(const struct text *, int);
 static int	nlprintw(int, int, int *, const char*, ...);
+static int	nltext(int, int, int *, const char *, const struct text *);
 
-void
-draw_error(char *msg)
-{
-	int i;
+/* Box drawing rows, built once per terminal size */
+enum rules {RULE_TOP, RULE_TEE, RULE_BOTTOM, RULE_MAX};
 
-	if (LINES < 6)
-		return;
+static struct {
+	int	 lines;
+	int	 cols;
+	cchar_t	*rule[RULE_MAX];	/* Rows of COLS cells */
+	cchar_t	 vline;
+} chrome;
 
-	/* Clear footer line */
-	for (i = 1; i < COLS-1; i++)
-		(void)mvprintw(LINES-2, i, " ");
-
-	(void)mvprintw(LINES-2, 2, "ERROR: %.*s", COLS-11, msg);
-	(void)refresh();
-	(void)sleep(3);	/* Display error for 3 seconds */
-}
+/* The terminal of a virtual screen */
+static SCREEN	*vscreen;
+static FILE	*vout;
+static FILE	*vin;
 
 void
 draw_exit(void)
 {
+	int i;
+
 	(void)endwin();
+	if (vscreen != NULL) {
+		delscreen(vscreen);
+		(void)fclose(vout);
+		(void)fclose(vin);
+		vscreen = NULL;
+	}
+	for (i = 0; i < RULE_MAX; i++) {
+		free(chrome.rule[i]);
+		chrome.rule[i] = NULL;
+	}
+	chrome.cols = 0;
 }
 
+/* With lines > 0 the screen is a virtual one of lines by cols, which
+ * is drawn like the terminal but never shown.
+ */
 void
-draw_init(void)
+draw_init(int lines, int cols)
 {
+	const char *term;
 	int ret;
 
-	if (initscr() == NULL)
+	if (lines > 0) {
+		vout = fopen("/dev/null", "w");
+		vin = fopen("/dev/null", "r");
+		if (vout == NULL || vin == NULL)
+			goto error;
+		term = getenv("TERM");
+		vscreen = newterm(term != NULL ? term : "xterm", vout, vin);
+		if (vscreen == NULL)
+			vscreen = newterm("xterm", vout, vin);
+		if (vscreen == NULL)
+			goto error;
+		(void)set_term(vscreen);
+		if (resizeterm(lines, cols) == ERR)
+			goto error;
+	} else if (initscr() == NULL)
 		goto error;
 
 	/* Set up ncurses environment */
@@ -50,8 +84,8 @@ draw_init(void)
 	if (ret == ERR)
 		goto error;
 
-	/* Set half-blocking mode and time */
-	ret = halfdelay(HALFDELAY);
+	/* Set cbreak mode, the input timeout is set by key_handle() */
+	ret = cbreak();
 	if (ret == ERR)
 		goto error;
 
@@ -85,22 +119,53 @@ error:
 	errx(1, "Failed to initialize ncurses.");
 }
 
+/* Update only the HUD rows */
+void
+draw_hud(struct info *data)
+{
+	if (data->headless == TRUE)
+		return;
+	hud_draw(data);
+	if (data->state == SEARCH || data->filtering == TRUE)
+		drawfooter(data);	/* Put the cursor back */
+	(void)refresh();
+}
+
 void
 draw_redraw(struct info *data)
 {
+	uint64_t start, heap;
+
+	/* There is no screen in daemon mode */
+	if (data->headless == TRUE)
+		return;
+
+	heap = data->replay != NULL ? heapinuse() : 0;
+	start = monotime();
 	(void)erase();
+	drawchrome();
 	drawheader(data);
 	drawbody(data);
+	hud_draw(data);
 	drawfooter(data);
 	(void)refresh();
+	start = monotime() - start;
+	hud_frame(data, start);
+	trace_event(TR_REDRAW, 0, start);
+
+	/* A search ends with its results on the screen */
+	if (data->state == SELECT)
+		bench_end(BENCH_SEARCH);
+	if (data->replay != NULL)
+		replay_frame(data, start, (int64_t)(heapinuse() - heap));
+	data->dirty = FALSE;
 }
 
 static void
 drawheader(struct info *data)
 {
-	char *mix, *track;
-	int index, i;
-	size_t len;
+	struct text *mix, *track;
+	int index;
 
 	if (data == NULL)
 		return;
@@ -113,53 +178,37 @@ drawheader(struct info *data)
 	track = NULL;
 	if (data->m) {
 		if (data->m->name)
-			mix = data->m->name;
+			mix = &data->m->name_text;
 		index = data->m->track_count;
-		if (index > 0) {
-			len = strlen(data->m->track[index-1]->name) + 
-			    strlen(" - ") +
-			    strlen(data->m->track[index-1]->performer) + 1;
-			track = malloc(len * sizeof(char));
-			if (track == NULL)
-				err(1, NULL);
-			track[0] = '\0';
-			(void)snprintf(track, len, "%s - %s",
-			    data->m->track[index-1]->performer,
-			    data->m->track[index-1]->name);
-		}
+		if (index > 0)
+			track = &data->m->track[index-1]->title;
 	}
 
 	/* First line */
-	(void)mvprintw(0, 0, "%lc", L'\u250C');
-	for (i = 1; i < COLS-1; i++)
-		(void)printw("%lc", L'\u2500');
-	(void)mvaddstr(0, 3, " 8p ");
-	(void)mvprintw(0, COLS-1, "%lc", L'\u2510');
+	drawrule(0, RULE_TOP);
+	if (fetch_online() == TRUE)
+		(void)mvaddstr(0, 3, " 8p ");
+	else
+		(void)mvaddstr(0, 3, " 8p (offline) ");
 
 	/* Second line */
-	(void)mvprintw(1, 0, "%lc", L'\u2502');
-	(void)mvprintw(1, COLS-1, "%lc", L'\u2502');
-	if (mix)
-		(void)mvprintw(1, 2, "Mix:   %.*s", COLS-4-7, mix);
-	else
-		(void)mvprintw(1, 2, "Mix:");
+	drawbar(1);
+	(void)mvprintw(1, 2, "Mix:");
+	if (mix) {
+		(void)move(1, 2+7);
+		drawclip(mix, COLS-4-7);
+	}
 
 	/* Third line */
-	(void)mvprintw(2, 0, "%lc", L'\u2502');
-	(void)mvprintw(2, COLS-1, "%lc", L'\u2502');
-	if (track)
-		(void)mvprintw(2, 2, "Track: %.*s", COLS-4-7, track);
-	else
-		(void)mvprintw(2, 2, "Track:");
-
-	/* Fourth line */
-	(void)mvprintw(3, 0, "%lc", L'\u2514');
-	for (i = 1; i < COLS-1; i++)
-		(void)printw("%lc", L'\u2500');
-	(void)mvprintw(3, COLS-1, "%lc", L'\u2518');
+	drawbar(2);
+	(void)mvprintw(2, 2, "Track:");
+	if (track) {
+		(void)move(2, 2+7);
+		drawclip(track, COLS-4-7);
+	}
 
-	if (track)
-		free(track);
+	/* Fourth line, joined to the body if there is one */
+	drawrule(3, LINES <= 6 ? RULE_BOTTOM : RULE_TEE);
 }
 
 static void
@@ -172,9 +221,6 @@ drawbody(struct info *data)
 	if (LINES <= 6)
 		return;
 
-	(void)mvprintw(3, 0, "%lc", L'\u251C');
-	(void)mvprintw(3, COLS-1, "%lc", L'\u2524');
-
 	switch (data->state) {
 	case START:	drawstart(data); break;
 	case SEARCH:	drawsearch(data); break;
@@ -185,15 +231,88 @@ drawbody(struct info *data)
 	}
 }
 
+/* The borders at both ends of a line */
+static void
+drawbar(int ln)
+{
+	drawchrome();
+	(void)mvadd_wch(ln, 0, &chrome.vline);
+	(void)mvadd_wch(ln, COLS-1, &chrome.vline);
+}
+
 static void
 drawbodyfill(int ln)
 {
-	for (; ln < LINES-3; ln++) {
-		(void)mvprintw(ln, 0, "%lc", L'\u2502');
-		(void)mvprintw(ln, COLS-1, "%lc", L'\u2502');
+	for (; ln < LINES-3; ln++)
+		drawbar(ln);
+}
+
+/* Build the box drawing rows if the terminal size changed, so a frame
+ * draws each of them with a single call.
+ */
+static void
+drawchrome(void)
+{
+	const wchar_t ends[RULE_MAX][2] = {
+		{ L'\u250C', L'\u2510' },	/* RULE_TOP */
+		{ L'\u251C', L'\u2524' },	/* RULE_TEE */
+		{ L'\u2514', L'\u2518' }	/* RULE_BOTTOM */
+	};
+	wchar_t wc[2];
+	int i, j;
+
+	if (chrome.lines == LINES && chrome.cols == COLS &&
+	    chrome.rule[0] != NULL)
+		return;
+	chrome.lines = LINES;
+	chrome.cols = COLS;
+
+	wc[1] = L'\0';
+	wc[0] = L'\u2502';
+	(void)setcchar(&chrome.vline, wc, A_NORMAL, 0, NULL);
+	for (i = 0; i < RULE_MAX; i++) {
+		free(chrome.rule[i]);
+		chrome.rule[i] = malloc(COLS * sizeof(cchar_t));
+		if (chrome.rule[i] == NULL)
+			err(1, NULL);
+		wc[0] = L'\u2500';
+		for (j = 1; j < COLS-1; j++)
+			(void)setcchar(&chrome.rule[i][j], wc, A_NORMAL, 0,
+			    NULL);
+		wc[0] = ends[i][0];
+		(void)setcchar(&chrome.rule[i][0], wc, A_NORMAL, 0, NULL);
+		wc[0] = ends[i][1];
+		(void)setcchar(&chrome.rule[i][COLS-1], wc, A_NORMAL, 0,
+		    NULL);
 	}
 }
 
+/* A horizontal rule across the screen */
+static void
+drawrule(int ln, int rule)
+{
+	drawchrome();
+	(void)mvadd_wchnstr(ln, 0, chrome.rule[rule], COLS);
+}
+
+/* Print as much of a text as fits into cols columns */
+static void
+drawclip(const struct text *t, int cols)
+{
+	size_t n;
+	int col;
+
+	if (t->width <= cols)
+		n = t->len;
+	else {
+		for (n = 0, col = 0; n < t->len &&
+		    col + (t->meta[n] & TEXT_WIDTH) <= cols; n++)
+			col += t->meta[n] & TEXT_WIDTH;
+	}
+	if (n > 0)
+		(void)addnwstr(t->s, (int)n);
+}
+
 static void
 drawstart(struct info *data)
 {
@@ -233,7 +352,15 @@ drawsearch(struct info *data)
 	int scroll;
 
 	scroll = data->scroll;
-	y = nlprintw(4, FALSE, &scroll, "%s", txt[0]);
+	y = 4;
+	if (data->suggest_count > 0) {
+		y = nlprintw(y, FALSE, &scroll, "Completions (Tab)");
+		for (i = 0; i < data->suggest_count; i++)
+			y = nlprintw(y, i == 0, &scroll, "%s",
+			    data->suggest[i]);
+		y = nlprintw(y, FALSE, &scroll, "\n");
+	}
+	y = nlprintw(y, FALSE, &scroll, "%s", txt[0]);
         for (i = 1; i < (int)(sizeof(txt)/sizeof(txt[0])); i++)
                 y = nlprintw(y, FALSE, &scroll, "%s", txt[i]);
 	drawbodyfill(y);
@@ -252,6 +379,10 @@ drawsearching(void)
 static void
 drawselect(struct info *data)
 {
+	const char *sort[SORT_MAX] = {"relevance", "plays", "likes", "name",
+	    "tracks"};
+	struct mix *m;
+	char dj[ENRICHNAME], label[16];
 	int scroll, y;
 	int i, j;
 
@@ -263,28 +394,40 @@ drawselect(struct info *data)
 		goto error;
 
 	y = 4;
-	for (j = 0, i = data->select_pos; j < (int)data->mlist_size; j++, i++) {
-		i = mod(i, data->mlist_size);
-		if (data->mlist[i] == NULL) {
+	if (data->sort != SORT_SERVER || data->filter_len > 0) {
+		y = nlprintw(y, FALSE, &scroll, "%zu of %zu mixes, by %s",
+		    data->view_size, data->mlist_size, sort[data->sort]);
+		y = nlprintw(y, FALSE, &scroll, "\n");
+	}
+	if (data->view_size == 0) {
+		y = nlprintw(y, FALSE, &scroll, "No mixes match the filter.");
+		drawbodyfill(y);
+		return;
+	}
+	for (j = 0, i = data->select_pos; j < (int)data->view_size; j++, i++) {
+		i = mod(i, data->view_size);
+		m = data->mlist[data->view[i]];
+		if (m == NULL) {
 			y = nlprintw(y, FALSE, &scroll, "-. Error");
 			continue;
 		}
+		(void)snprintf(label, sizeof(label), "%d. ",
+		    data->view[i] + 1);
 		if (i == data->select_pos) {
-			y = nlprintw(y, TRUE, &scroll, "%d. %s", i+1,
-			    data->mlist[i]->name);
+			y = nltext(y, TRUE, &scroll, label, &m->name_text);
 			y = nlprintw(y, FALSE, &scroll, "");
-		} else {
-			y = nlprintw(y, FALSE, &scroll, "%d. %s", i+1,
-			    data->mlist[i]->name);
-		}
-		y = nlprintw(y, FALSE, &scroll, "\nDescription:\n%s",
-		    data->mlist[i]->description);
-		y = nlprintw(y, FALSE, &scroll, "Tags: %s",
-		    data->mlist[i]->tags);
+		} else
+			y = nltext(y, FALSE, &scroll, label, &m->name_text);
+		if (enrich_name(m->user_id, dj, sizeof(dj)) == ERROR)
+			(void)strlcpy(dj, "...", sizeof(dj));
+		y = nlprintw(y, FALSE, &scroll, "\nDJ: %s", dj);
+		y = nlprintw(y, FALSE, &scroll, "Description:");
+		y = nltext(y, FALSE, &scroll, "", &m->description_text);
+		y = nltext(y, FALSE, &scroll, "Tags: ", &m->tags_text);
 		y = nlprintw(y, FALSE, &scroll, "Number of plays: %d",
-		    data->mlist[i]->plays_count);
+		    m->plays_count);
 		y = nlprintw(y, FALSE, &scroll, "Number of likes: %d",
-		    data->mlist[i]->likes_count);
+		    m->likes_count);
 		y = nlprintw(y, FALSE, &scroll, "\n---\n\n");
 	} 
 	drawbodyfill(y);
@@ -299,16 +442,30 @@ error:
 static void
 drawplay(struct info *data)
 {
+	struct cachestats st;
+	char label[16];
 	int scroll, y, i;
 
 	scroll = data->scroll;
 	y = nlprintw(4, FALSE, &scroll, "Playlist");
 	y = nlprintw(y, FALSE, &scroll, "--------");
 	for (i = 0; i < data->m->track_count; i++) {
-		y = nlprintw(y, FALSE, &scroll, "%d. %s - %s", i+1,
-		    data->m->track[i]->performer,
-		    data->m->track[i]->name);
+		(void)snprintf(label, sizeof(label), "%d. ", i+1);
+		y = nltext(y, FALSE, &scroll, label,
+		    &data->m->track[i]->title);
+	}
+	if (data->stream != NULL) {
+		y = nlprintw(y, FALSE, &scroll, "\n");
+		y = nlprintw(y, FALSE, &scroll, "Buffer: %d%%  Stalls: %llu",
+		    stream_fill(data->stream),
+		    (unsigned long long)stream_stalls(data->stream));
 	}
+	cache_stats(&st);
+	if (st.hits + st.misses > 0)
+		y = nlprintw(y, FALSE, &scroll,
+		    "Cache: %llu%% hits  %llu MiB saved",
+		    (unsigned long long)(st.hits * 100 / (st.hits + st.misses)),
+		    (unsigned long long)(st.saved / (1024 * 1024)));
 	drawbodyfill(y);
 }
 
@@ -318,28 +475,39 @@ drawfooter(struct info *data)
 	char playing[] = "q Quit  s Search  p Play/Pause  n Next track"
 	    "  N Next mix";
 	char search[] = "ESC Exit |  Search: ";
-	char select[] = "ESC Exit  Enter Select";
+	char select[] = "ESC Exit  Enter Select  Tab Sort  / Filter";
+	char filter[] = "ESC Clear  Enter Done |  Filter: ";
 	char start[] = "q Quit  s Search";
+	struct notice *n;
 	struct search_node *it;
-	int cp, i;
+	int cp, i, w;
 
 	if (data == NULL)
 		return;
 	if (LINES < 6)
 		return;
 
-	(void)mvprintw(LINES-3, 0, "%lc", L'\u251C');
-	for (i = 1; i < COLS-1; i++)
-		(void)printw("%lc", L'\u2500');
-	(void)printw("%lc", L'\u2524');
-	
-	(void)mvprintw(LINES-2, 0, "%lc", L'\u2502');
-	(void)mvprintw(LINES-2, COLS-1, "%lc", L'\u2502');
-
-	(void)mvprintw(LINES-1, 0, "%lc", L'\u2514');
-	for (i = 1; i < COLS-1; i++)
-		(void)printw("%lc", L'\u2500');
-	(void)mvprintw(LINES-1, COLS-1, "%lc", L'\u2518');
+	drawrule(LINES-3, RULE_TEE);
+	drawbar(LINES-2);
+	drawrule(LINES-1, RULE_BOTTOM);
+
+	/* Notifications replace the key help, except while typing */
+	n = notify_current(data);
+	if (n != NULL && data->state != SEARCH) {
+		/* A negative precision would print all of the message */
+		w = COLS-11;
+		if (n->count > 1)
+			w -= 4 + (int)intlen(n->count);
+		if (w < 0)
+			w = 0;
+		if (n->count > 1)
+			(void)mvprintw(LINES-2, 2, "ERROR: %.*s (x%d)", w,
+			    n->msg, n->count);
+		else
+			(void)mvprintw(LINES-2, 2, "ERROR: %.*s", w, n->msg);
+		(void)curs_set(0);
+		return;
+	}
 
 	switch (data->state) {
 	case PLAY:
@@ -354,6 +522,12 @@ drawfooter(struct info *data)
 		(void)mvprintw(LINES-2, 2, "%.*s", COLS-4, search);
 		for (it = data->slist_head; it != NULL; it = it->next)
 			(void)printw("%lc", it->c);
+		if (data->suggest_count > 0) {
+			(void)attron(A_DIM);
+			(void)printw("%s",
+			    data->suggest[0] + data->suggest_skip);
+			(void)attroff(A_DIM);
+		}
 		(void)curs_set(1);
 		cp = strlen(search) + 2;
 		it = data->slist_head;
@@ -362,6 +536,12 @@ drawfooter(struct info *data)
 		(void)move(LINES-2, cp);
 		break;
 	case SELECT:
+		if (data->filtering == TRUE) {
+			(void)mvprintw(LINES-2, 2, "%.*s", COLS-4, filter);
+			(void)printw("%ls", data->filter);
+			(void)curs_set(1);
+			break;
+		}
 		(void)mvprintw(LINES-2, 2, "%.*s", COLS-4, select);
 		(void)curs_set(0);
 		break;
@@ -437,7 +617,7 @@ nlprintw(int ln, int sel, int *scroll, const char *fmt, ...)
 		}
 	}
 	while (ln < LINES - 3 && wstr[i] != L'\0') {
-		(void)mvprintw(ln, 0, "%lc", L'\u2502');
+		(void)mvadd_wch(ln, 0, &chrome.vline);
 		(void)move(ln, 2);
 		if (sel == TRUE)
 			(void)attron(A_REVERSE);
@@ -451,7 +631,7 @@ nlprintw(int ln, int sel, int *scroll, const char *fmt, ...)
 			(void)addch(wstr[i]);
 			i++;
 		}
-		(void)mvprintw(ln, COLS-1, "%lc", L'\u2502');
+		(void)mvadd_wch(ln, COLS-1, &chrome.vline);
 		ln++;
 	}
 
@@ -469,3 +649,42 @@ error:
 
 	return ln;
 }
+
+/* Print a display form like nlprintw(), after an ASCII label, wrapping
+ * it at the breaks found when it was made.
+ */
+static int
+nltext(int ln, int sel, int *scroll, const char *label,
+    const struct text *t)
+{
+	size_t pos, next, n;
+	int first;
+
+	if (*label == '\0' && t->len == 0)
+		return ln;
+	for (pos = 0, first = TRUE; first == TRUE || pos < t->len;
+	    first = FALSE, pos = next) {
+		n = text_wrap(t, pos, COLS-5 -
+		    (first == TRUE ? (int)strlen(label) : 0), &next);
+		if (*scroll > 0) {
+			(*scroll)--;
+			continue;
+		}
+		if (ln >= LINES - 3)
+			break;
+		(void)mvadd_wch(ln, 0, &chrome.vline);
+		(void)move(ln, 2);
+		if (sel == TRUE)
+			(void)attron(A_REVERSE);
+		if (first == TRUE)
+			(void)addstr(label);
+		if (n > 0)
+			(void)addnwstr(t->s + pos, (int)n);
+		if (sel == TRUE)
+			(void)attroff(A_REVERSE);
+		(void)mvadd_wch(ln, COLS-1, &chrome.vline);
+		ln++;
+	}
+
+	return ln;
+}
@@ -12,14 +12,23 @@
 #include <string.h>
 #include <unistd.h>
 #include <wchar.h>
+#include "bench.h"
+#include "cache.h"
 #include "defs.h"
+#include "enrich.h"
+#include "fetch.h"
+#include "hud.h"
 #include "mix.h"
+#include "notify.h"
+#include "replay.h"
+#include "stream.h"
 #include "string.h"
+#include "trace.h"
 #include "util.h"
 
-void	draw_error(char *);
 void	draw_exit(void);
-void	draw_init(void);
+void	draw_hud(struct info *);
+void	draw_init(int, int);
 void	draw_redraw(struct info *);
 
 #endif
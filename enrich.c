@@ -0,0 +1,281 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "enrich.h"
+
+static void	 enrich_resolve(int);
+static void	 enrich_set(int, const char *);
+static void	*enrich_worker(void *);
+
+/* Details of the mixes in the select view that the search response
+ * lacks, the names of their DJs, are looked up in the background by a
+ * pool of workers.  Results are kept in a direct-mapped cache for
+ * ENRICHTTL seconds, failures for ENRICHRETRY.  A lookup that is in
+ * flight is waited for instead of being made again.
+ */
+enum slotstates {SLOT_EMPTY, SLOT_FLIGHT, SLOT_DONE, SLOT_FAILED};
+
+struct enrichslot {
+	int		 user_id;
+	int		 state;
+	uint64_t	 expires;	/* Monotonic time in ns */
+	char		 name[ENRICHNAME];
+};
+struct enrichjob {
+	int		 user_id;
+	struct info	*data;		/* Zone that asked */
+};
+
+static pthread_mutex_t	 enrich_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	 enrich_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	 enrich_landed = PTHREAD_COND_INITIALIZER;
+static struct enrichslot slots[ENRICHCACHE];
+static struct enrichjob	*queue = NULL;
+static size_t		 nqueue = 0;
+static size_t		 queue_cap = 0;
+static pthread_t	*workers = NULL;
+static int		 nworkers = 0;
+static int		 jobs = 0;
+static int		 inflight = 0;
+static int		 quit = FALSE;
+static unsigned int	 generation = 0;	/* Results landed */
+
+void
+enrich_exit(void)
+{
+	int i;
+
+	(void)pthread_mutex_lock(&enrich_lock);
+	quit = TRUE;
+	(void)pthread_cond_broadcast(&enrich_queued);
+	(void)pthread_mutex_unlock(&enrich_lock);
+	for (i = 0; i < nworkers; i++)
+		(void)pthread_join(workers[i], NULL);
+	free(workers);
+	workers = NULL;
+	nworkers = 0;
+	free(queue);
+	queue = NULL;
+	nqueue = 0;
+}
+
+/* At most n lookups run at the same time, none with 0 */
+int
+enrich_init(int n)
+{
+	jobs = n;
+	memset(slots, 0, sizeof(slots));
+
+	return SUCCESS;
+}
+
+/* Copy the name of a DJ if it is known.  A stale name is still used
+ * while it is looked up again.
+ */
+int
+enrich_name(int user_id, char *buf, size_t len)
+{
+	struct enrichslot *s;
+	int errn;
+
+	errn = ERROR;
+	(void)pthread_mutex_lock(&enrich_lock);
+	s = &slots[(unsigned int)user_id % ENRICHCACHE];
+	if (s->user_id == user_id && s->name[0] != '\0') {
+		(void)strlcpy(buf, s->name, len);
+		errn = SUCCESS;
+	}
+	(void)pthread_mutex_unlock(&enrich_lock);
+
+	return errn;
+}
+
+/* Whether lookups landed since the zone last asked */
+int
+enrich_poll(struct info *data)
+{
+	unsigned int g;
+
+	g = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+	if (g == data->enrich_seen)
+		return FALSE;
+	data->enrich_seen = g;
+
+	return TRUE;
+}
+
+/* Remember a name that came with a response */
+void
+enrich_seed(int user_id, const char *name)
+{
+	struct enrichslot *s;
+
+	if (user_id <= 0 || name == NULL || *name == '\0')
+		return;
+	(void)pthread_mutex_lock(&enrich_lock);
+	s = &slots[(unsigned int)user_id % ENRICHCACHE];
+	if (s->state != SLOT_FLIGHT)
+		enrich_set(user_id, name);
+	(void)pthread_mutex_unlock(&enrich_lock);
+}
+
+/* Queue lookups for the mixes found by a search of the zone, replacing
+ * those queued for its previous search.
+ */
+void
+enrich_start(struct info *data)
+{
+	struct enrichslot *s;
+	uint64_t now;
+	size_t i, j, n;
+	int id;
+
+	if (jobs == 0 || data->mlist == NULL)
+		return;
+
+	now = monotime();
+	(void)pthread_mutex_lock(&enrich_lock);
+	for (i = 0, n = 0; i < nqueue; i++) {
+		if (queue[i].data != data)
+			queue[n++] = queue[i];
+	}
+	nqueue = n;
+	for (i = 0; i < data->mlist_size; i++) {
+		if (data->mlist[i] == NULL || data->mlist[i]->user_id <= 0)
+			continue;
+		id = data->mlist[i]->user_id;
+		s = &slots[(unsigned int)id % ENRICHCACHE];
+		if (s->user_id == id && (s->state == SLOT_FLIGHT ||
+		    (s->state != SLOT_EMPTY && now < s->expires)))
+			continue;
+		for (j = 0; j < nqueue && queue[j].user_id != id; j++)
+			;
+		if (j < nqueue)
+			continue;
+		if (nqueue == queue_cap) {
+			queue_cap = queue_cap > 0 ? queue_cap * 2 : 64;
+			queue = realloc(queue,
+			    queue_cap * sizeof(struct enrichjob));
+			if (queue == NULL)
+				err(1, NULL);
+		}
+		queue[nqueue].user_id = id;
+		queue[nqueue].data = data;
+		nqueue++;
+	}
+
+	/* The workers are started by the first search */
+	if (workers == NULL && nqueue > 0) {
+		workers = malloc(jobs * sizeof(pthread_t));
+		if (workers == NULL)
+			err(1, NULL);
+		for (; nworkers < jobs; nworkers++) {
+			if (pthread_create(&workers[nworkers], NULL,
+			    enrich_worker, NULL) != 0)
+				break;
+		}
+	}
+	(void)pthread_cond_broadcast(&enrich_queued);
+	(void)pthread_mutex_unlock(&enrich_lock);
+}
+
+/* Milliseconds until results should be looked for again */
+int
+enrich_timeout(struct info *data)
+{
+	int busy;
+
+	if (data->state != SELECT)
+		return HALFDELAY * 100;
+	(void)pthread_mutex_lock(&enrich_lock);
+	busy = nqueue > 0 || inflight > 0;
+	(void)pthread_mutex_unlock(&enrich_lock);
+
+	return busy == TRUE ? ENRICHPOLL : HALFDELAY * 100;
+}
+
+static void
+enrich_resolve(int user_id)
+{
+	struct apiargs args;
+	struct enrichslot *s;
+	json_t *root, *user, *login;
+
+	(void)pthread_mutex_lock(&enrich_lock);
+	s = &slots[(unsigned int)user_id % ENRICHCACHE];
+	for (;;) {
+		if (s->state == SLOT_FLIGHT)
+			(void)pthread_cond_wait(&enrich_landed, &enrich_lock);
+		else if (s->user_id == user_id && s->state != SLOT_EMPTY &&
+		    monotime() < s->expires) {
+			(void)pthread_mutex_unlock(&enrich_lock);
+			return;
+		} else
+			break;
+	}
+	if (s->user_id != user_id)
+		s->name[0] = '\0';
+	s->user_id = user_id;
+	s->state = SLOT_FLIGHT;
+	inflight++;
+	(void)pthread_mutex_unlock(&enrich_lock);
+
+	memset(&args, 0, sizeof(args));
+	args.user_id = user_id;
+	root = api_get(API_USER, &args, &user);
+	login = root != NULL ? json_object_get(user, "login") : NULL;
+
+	(void)pthread_mutex_lock(&enrich_lock);
+	enrich_set(user_id, json_is_string(login) ?
+	    json_string_value(login) : NULL);
+	inflight--;
+	(void)pthread_cond_broadcast(&enrich_landed);
+	(void)pthread_mutex_unlock(&enrich_lock);
+	if (root != NULL)
+		json_decref(root);
+}
+
+/* Fill in the slot of a DJ, a failure keeps the name it had */
+static void
+enrich_set(int user_id, const char *name)
+{
+	struct enrichslot *s;
+
+	s = &slots[(unsigned int)user_id % ENRICHCACHE];
+	if (s->user_id != user_id)
+		s->name[0] = '\0';
+	s->user_id = user_id;
+	if (name != NULL) {
+		(void)strlcpy(s->name, name, sizeof(s->name));
+		s->state = SLOT_DONE;
+		s->expires = monotime() + ENRICHTTL * 1000000000ULL;
+	} else {
+		s->state = SLOT_FAILED;
+		s->expires = monotime() + ENRICHRETRY * 1000000000ULL;
+	}
+	(void)__atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+}
+
+static void *
+enrich_worker(void *arg)
+{
+	int user_id;
+
+	(void)arg;
+	(void)fetch_class(FC_PREFETCH);
+	(void)pthread_mutex_lock(&enrich_lock);
+	for (;;) {
+		while (nqueue == 0 && quit == FALSE)
+			(void)pthread_cond_wait(&enrich_queued, &enrich_lock);
+		if (quit == TRUE)
+			break;
+		user_id = queue[0].user_id;
+		(void)memmove(queue, queue + 1,
+		    --nqueue * sizeof(struct enrichjob));
+		(void)pthread_mutex_unlock(&enrich_lock);
+		enrich_resolve(user_id);
+		(void)pthread_mutex_lock(&enrich_lock);
+	}
+	(void)pthread_mutex_unlock(&enrich_lock);
+
+	return NULL;
+}
@@ -0,0 +1,26 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef ENRICH_H
+#define ENRICH_H
+
+#include <bsd/string.h>
+#include <err.h>
+#include <jansson.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "api.h"
+#include "defs.h"
+#include "fetch.h"
+#include "util.h"
+
+void	enrich_exit(void);
+int	enrich_init(int);
+int	enrich_name(int, char *, size_t);
+int	enrich_poll(struct info *);
+void	enrich_seed(int, const char *);
+void	enrich_start(struct info *);
+int	enrich_timeout(struct info *);
+
+#endif
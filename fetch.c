@@ -2,7 +2,56 @@
 
 #include "fetch.h"
 
-static size_t	write(void *, size_t, size_t, void *);
+static void	*fetch_initsession(void *);
+static void	*fetch_probe(void *);
+static int	 fetch_progress(void *, curl_off_t, curl_off_t, curl_off_t,
+		    curl_off_t);
+static void	 fetch_result(int);
+static void	 lock(CURL *, curl_lock_data, curl_lock_access, void *);
+static void	 unlock(CURL *, curl_lock_data, void *);
+static size_t	 writebuf(void *, size_t, size_t, void *);
+
+/* The curl session is shared by every request: DNS results and open
+ * connections are kept between fetches instead of being set up anew.
+ */
+static CURLSH		*share = NULL;
+static pthread_mutex_t	 share_lock[CURL_LOCK_DATA_LAST];
+static pthread_mutex_t	 session_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t	 session_thread;
+static int		 session_pending = FALSE;
+static int		 session_status = ERROR;
+
+/* After OFFLINEFAILS consecutive failed requests 8p goes offline: API
+ * requests fail immediately and are served from the response store,
+ * while a probe thread checks every OFFLINEPROBE seconds whether the
+ * network is back.
+ */
+static pthread_mutex_t	 net_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	 net_cond = PTHREAD_COND_INITIALIZER;
+static int		 net_online = TRUE;
+static int		 net_failures = 0;
+static int		 net_exit = FALSE;
+static pthread_t	 probe_thread;
+static int		 probe_running = FALSE;
+
+/* Every request url starts with the API base, set before fetch_init() */
+static char		 api_base[APIURL] = APIBASE;
+
+/* Requests are admitted by priority class, each thread issues requests
+ * of one class at a time.  Every class has a limit of requests in
+ * flight, stream downloads count against the playback class.
+ * Prefetches and reports wait while interactive requests are queued or
+ * running.  Running prefetches are aborted and retried afterwards,
+ * running reports that were not sent yet are aborted and queued again
+ * by report().  Bulk downloads are shaped to FETCHSHAPE KiB/s meanwhile.
+ */
+static const int	 sched_limit[FC_MAX] = {4, ZONEMAX, 2, 1};
+static pthread_mutex_t	 sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	 sched_cond = PTHREAD_COND_INITIALIZER;
+static int		 sched_running[FC_MAX];
+static int		 sched_urgent = 0;	/* Interactive requests */
+static __thread int	 sched_class = FC_INTERACTIVE;
+static __thread uint64_t shape_next = 0;
 
 int
 fetch(char **js, const char *url)
@@ -11,18 +60,22 @@ fetch(char **js, const char *url)
 	CURLcode curl_err;
 	struct buffer buf;
 	struct curl_slist *headers;
-	
+	int cls, endpoint;
+
 	if (url == NULL || *js == NULL)
 		return ERROR;
+	if (fetch_online() == FALSE)
+		return ERROR;
 
 	/* Initialize */
 	headers = NULL;
 	curl = NULL;
 
-	/* Set up curl */
-	curl_err = curl_global_init(CURL_GLOBAL_ALL);
-	if (curl_err != 0)
+	/* Wait for the session set up by fetch_init() */
+	if (fetch_wait() == ERROR)
 		return ERROR;
+
+	/* Set up curl */
 	curl = curl_easy_init();
 	if (curl == NULL)
 		goto error;
@@ -40,21 +93,54 @@ fetch(char **js, const char *url)
 		goto error;
 
 	/* Set up curl request */
+	curl_err = curl_easy_setopt(curl, CURLOPT_SHARE, share);
+	if (curl_err != 0)
+		goto error;
+	curl_err = curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	if (curl_err != 0)
+		goto error;
 	curl_err = curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 	if (curl_err != 0)
 		goto error;
 	curl_err = curl_easy_setopt(curl, CURLOPT_URL, url);
 	if (curl_err != 0)
 		goto error;
-	curl_err = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write);
+	curl_err = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writebuf);
 	if (curl_err != 0)
 		goto error;
 	curl_err = curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&buf);
+	if (curl_err != 0)
+		goto error;
+	curl_err = curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
+	    fetch_progress);
+	if (curl_err != 0)
+		goto error;
+	curl_err = curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *)curl);
+	if (curl_err != 0)
+		goto error;
+	curl_err = curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
 	if (curl_err != 0)
 		goto error;
 
-	/* Perform request */
-	curl_err = curl_easy_perform(curl);
+	/* Perform request, again if interactive requests preempted it.  A
+	 * preempted report fails instead, it goes back to the queue.
+	 */
+	cls = sched_class;
+	endpoint = netlog_endpoint(url);
+	do {
+		fetch_admit(cls);
+		buf.pos = 0;
+		trace_event(TR_FETCH, (uint32_t)endpoint, 0);
+		netlog_start();
+		curl_err = curl_easy_perform(curl);
+		netlog_record(curl, endpoint, curl_err);
+		trace_event(TR_FETCHED, (uint32_t)endpoint,
+		    (uint64_t)curl_err);
+		fetch_release(cls);
+	} while (curl_err == CURLE_ABORTED_BY_CALLBACK && cls != FC_REPORT);
+	if (curl_err == CURLE_ABORTED_BY_CALLBACK)
+		goto error;
+	fetch_result(curl_err == 0 ? SUCCESS : ERROR);
 	if (curl_err != 0)
 		goto error;
 
@@ -67,7 +153,6 @@ fetch(char **js, const char *url)
 	/* Cleanup */
 	curl_easy_cleanup(curl);
 	curl_slist_free_all(headers);
-	curl_global_cleanup();
 
 	return SUCCESS;
 
@@ -76,13 +161,416 @@ error:
 		curl_easy_cleanup(curl);
 	if (headers)
 		curl_slist_free_all(headers);
-	curl_global_cleanup();
-	
+
+	return ERROR;
+}
+
+/* The base url of the API, APIBASE unless replaced by fetch_setbase() */
+const char *
+fetch_base(void)
+{
+	return api_base;
+}
+
+/* Set the class of the requests of the calling thread, returns the
+ * previous one.
+ */
+int
+fetch_class(int cls)
+{
+	int prev;
+
+	prev = sched_class;
+	sched_class = cls;
+
+	return prev;
+}
+
+/* Use another server for the API, a slash is added if missing */
+int
+fetch_setbase(const char *url)
+{
+	size_t len;
+
+	len = strlen(url);
+	if (len == 0 || len + 2 > sizeof(api_base))
+		return ERROR;
+	(void)snprintf(api_base, sizeof(api_base), "%s%s", url,
+	    url[len - 1] == '/' ? "" : "/");
+
+	return SUCCESS;
+}
+
+/* Called by bulk downloads with the bytes just received.  While
+ * interactive requests are in flight it sleeps long enough to keep the
+ * download at FETCHSHAPE KiB/s.
+ */
+void
+fetch_shape(size_t len)
+{
+	struct timespec ts;
+	uint64_t now, wait;
+
+	if (__atomic_load_n(&sched_urgent, __ATOMIC_RELAXED) == 0) {
+		shape_next = 0;
+		return;
+	}
+
+	now = monotime();
+	if (shape_next < now)
+		shape_next = now;
+	shape_next += (uint64_t)len * 1000000000 / (FETCHSHAPE * 1024);
+	wait = shape_next - now;
+	if (wait == 0)
+		return;
+	ts.tv_sec = (time_t)(wait / 1000000000);
+	ts.tv_nsec = (long)(wait % 1000000000);
+	(void)nanosleep(&ts, NULL);
+}
+
+/* An easy handle on the shared session for media transfers, which
+ * follow redirects and do not carry the API headers.
+ */
+CURL *
+fetch_handle(void)
+{
+	CURL *curl;
+
+	if (fetch_wait() == ERROR)
+		return NULL;
+
+	curl = curl_easy_init();
+	if (curl == NULL)
+		return NULL;
+	(void)curl_easy_setopt(curl, CURLOPT_SHARE, share);
+	(void)curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	(void)curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	(void)curl_easy_setopt(curl, CURLOPT_USERAGENT, "8p");
+
+	return curl;
+}
+
+/* Follow the redirects of a stream url and replace it with the final
+ * location, so the player connects to the media server directly.
+ */
+int
+fetch_resolve(char **url)
+{
+	CURL *curl;
+	CURLcode curl_err;
+	char *location;
+	size_t len;
+	int cls;
+
+	if (url == NULL || *url == NULL || fetch_online() == FALSE)
+		return ERROR;
+
+	curl = fetch_handle();
+	if (curl == NULL)
+		return ERROR;
+	(void)curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	(void)curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+	(void)curl_easy_setopt(curl, CURLOPT_URL, *url);
+	cls = sched_class;
+	fetch_admit(cls);
+	curl_err = curl_easy_perform(curl);
+	fetch_release(cls);
+	if (curl_err != 0)
+		goto error;
+	location = NULL;
+	curl_err = curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &location);
+	if (curl_err != 0 || location == NULL)
+		goto error;
+
+	len = strlen(location) + 1;
+	free(*url);
+	*url = malloc(len * sizeof(char));
+	if (*url == NULL)
+		err(1, NULL);
+	(void)strlcpy(*url, location, len);
+
+	curl_easy_cleanup(curl);
+
+	return SUCCESS;
+
+error:
+	curl_easy_cleanup(curl);
+
 	return ERROR;
 }
 
+/* Fetch an API request, or serve the stored response for key if the
+ * request fails.  Without an url only the store is used.
+ */
+int
+fetch_stored(char **js, const char *url, const char *key)
+{
+	char *stored;
+
+	if (url != NULL && fetch(js, url) == SUCCESS)
+		return SUCCESS;
+
+	stored = store_get(key);
+	if (stored == NULL)
+		return ERROR;
+	free(*js);
+	*js = stored;
+
+	return SUCCESS;
+}
+
+/* Stay offline, only stored responses are used from now on */
+void
+fetch_offline(void)
+{
+	(void)pthread_mutex_lock(&net_lock);
+	net_online = FALSE;
+	(void)pthread_mutex_unlock(&net_lock);
+}
+
+int
+fetch_online(void)
+{
+	int online;
+
+	(void)pthread_mutex_lock(&net_lock);
+	online = net_online;
+	(void)pthread_mutex_unlock(&net_lock);
+
+	return online;
+}
+
+void
+fetch_exit(void)
+{
+	int i;
+
+	(void)pthread_mutex_lock(&net_lock);
+	net_exit = TRUE;
+	(void)pthread_cond_broadcast(&net_cond);
+	(void)pthread_mutex_unlock(&net_lock);
+	if (probe_running == TRUE)
+		(void)pthread_join(probe_thread, NULL);
+
+	if (fetch_wait() == ERROR)
+		return;
+	(void)curl_share_cleanup(share);
+	share = NULL;
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		(void)pthread_mutex_destroy(&share_lock[i]);
+	curl_global_cleanup();
+}
+
+/* Set up the curl session on a background thread, so the first frame
+ * does not wait for curl and the resolver.
+ */
+int
+fetch_init(struct info *data)
+{
+	int errn;
+
+	errn = pthread_create(&session_thread, NULL, fetch_initsession,
+	    (void *)data);
+	if (errn != 0)
+		return ERROR;
+	session_pending = TRUE;
+
+	return SUCCESS;
+}
+
+int
+fetch_wait(void)
+{
+	(void)pthread_mutex_lock(&session_lock);
+	if (session_pending == TRUE) {
+		(void)pthread_join(session_thread, NULL);
+		session_pending = FALSE;
+	}
+	(void)pthread_mutex_unlock(&session_lock);
+
+	return session_status;
+}
+
+/* Wait for a slot of the class */
+void
+fetch_admit(int cls)
+{
+	(void)pthread_mutex_lock(&sched_lock);
+	if (cls == FC_INTERACTIVE)
+		__atomic_add_fetch(&sched_urgent, 1, __ATOMIC_RELAXED);
+	while (sched_running[cls] >= sched_limit[cls] ||
+	    (cls >= FC_PREFETCH && sched_urgent > 0))
+		(void)pthread_cond_wait(&sched_cond, &sched_lock);
+	sched_running[cls]++;
+	(void)pthread_mutex_unlock(&sched_lock);
+}
+
+void
+fetch_release(int cls)
+{
+	(void)pthread_mutex_lock(&sched_lock);
+	sched_running[cls]--;
+	if (cls == FC_INTERACTIVE)
+		__atomic_sub_fetch(&sched_urgent, 1, __ATOMIC_RELAXED);
+	(void)pthread_cond_broadcast(&sched_cond);
+	(void)pthread_mutex_unlock(&sched_lock);
+}
+
+static void *
+fetch_initsession(void *arg)
+{
+	CURL *curl;
+	CURLcode curl_err;
+	struct info *data;
+	int i;
+
+	data = (struct info *)arg;
+	curl = NULL;
+
+	curl_err = curl_global_init(CURL_GLOBAL_ALL);
+	if (curl_err != 0)
+		return NULL;
+
+	/* Share DNS and connections between all requests */
+	share = curl_share_init();
+	if (share == NULL)
+		goto error;
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		(void)pthread_mutex_init(&share_lock[i], NULL);
+	(void)curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+	(void)curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+	(void)curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	(void)curl_share_setopt(share, CURLSHOPT_SHARE,
+	    CURL_LOCK_DATA_CONNECT);
+	session_status = SUCCESS;
+
+	/* Resolve and connect once, so the first API request finds a warm
+	 * DNS cache and an open connection.  Failure is not fatal here,
+	 * the request will simply be retried by the first fetch.
+	 */
+	curl = fetch_online() == TRUE ? curl_easy_init() : NULL;
+	if (curl != NULL) {
+		(void)curl_easy_setopt(curl, CURLOPT_SHARE, share);
+		(void)curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+		(void)curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+		(void)curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+		(void)curl_easy_setopt(curl, CURLOPT_URL, api_base);
+		(void)curl_easy_perform(curl);
+		curl_easy_cleanup(curl);
+	}
+	data->phase[PHASE_NET] = monotime() - data->start;
+
+	return NULL;
+
+error:
+	curl_global_cleanup();
+
+	return NULL;
+}
+
+/* Count consecutive failures and go offline after OFFLINEFAILS */
+static void
+fetch_result(int errn)
+{
+	(void)pthread_mutex_lock(&net_lock);
+	if (errn == SUCCESS)
+		net_failures = 0;
+	else if (++net_failures >= OFFLINEFAILS && net_online == TRUE) {
+		net_online = FALSE;
+		if (probe_running == TRUE)
+			(void)pthread_join(probe_thread, NULL);
+		probe_running = pthread_create(&probe_thread, NULL,
+		    fetch_probe, NULL) == 0 ? TRUE : FALSE;
+	}
+	(void)pthread_mutex_unlock(&net_lock);
+}
+
+static void *
+fetch_probe(void *arg)
+{
+	CURL *curl;
+	CURLcode curl_err;
+	struct timespec ts;
+
+	(void)arg;
+
+	(void)pthread_mutex_lock(&net_lock);
+	while (net_exit == FALSE && net_online == FALSE) {
+		(void)clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += OFFLINEPROBE;
+		(void)pthread_cond_timedwait(&net_cond, &net_lock, &ts);
+		if (net_exit == TRUE)
+			break;
+		(void)pthread_mutex_unlock(&net_lock);
+
+		curl_err = CURLE_FAILED_INIT;
+		curl = fetch_handle();
+		if (curl != NULL) {
+			(void)curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+			(void)curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+			(void)curl_easy_setopt(curl, CURLOPT_URL, api_base);
+			curl_err = curl_easy_perform(curl);
+			curl_easy_cleanup(curl);
+		}
+
+		(void)pthread_mutex_lock(&net_lock);
+		if (curl_err == CURLE_OK) {
+			net_online = TRUE;
+			net_failures = 0;
+		}
+	}
+	(void)pthread_mutex_unlock(&net_lock);
+
+	return NULL;
+}
+
+/* Abort prefetches when interactive requests arrive, they only read
+ * and are sent again.  A report changes the play count of the server,
+ * so it is aborted only before the request was sent.
+ */
+static int
+fetch_progress(void *arg, curl_off_t dltotal, curl_off_t dlnow,
+    curl_off_t ultotal, curl_off_t ulnow)
+{
+	curl_off_t sent;
+
+	(void)dltotal;
+	(void)dlnow;
+	(void)ultotal;
+	(void)ulnow;
+
+	if (sched_class < FC_PREFETCH ||
+	    __atomic_load_n(&sched_urgent, __ATOMIC_RELAXED) == 0)
+		return 0;
+	if (sched_class == FC_REPORT &&
+	    (curl_easy_getinfo((CURL *)arg, CURLINFO_PRETRANSFER_TIME_T,
+	    &sent) != CURLE_OK || sent > 0))
+		return 0;
+
+	return 1;
+}
+
+static void
+lock(CURL *curl, curl_lock_data type, curl_lock_access access, void *userp)
+{
+	(void)curl;
+	(void)access;
+	(void)userp;
+
+	(void)pthread_mutex_lock(&share_lock[type]);
+}
+
+static void
+unlock(CURL *curl, curl_lock_data type, void *userp)
+{
+	(void)curl;
+	(void)userp;
+
+	(void)pthread_mutex_unlock(&share_lock[type]);
+}
+
 static size_t
-write(void *contents, size_t size, size_t nmemb, void *stream)
+writebuf(void *contents, size_t size, size_t nmemb, void *stream)
 {
 	struct buffer *buf;
 
@@ -93,6 +581,6 @@ write(void *contents, size_t size, size_t nmemb, void *stream)
 	memcpy(&(buf->data[buf->pos]), contents, size * nmemb);
 	buf->pos += size * nmemb;
 	buf->data[buf->pos] = '\0';
-	
+
 	return size * nmemb;
 }
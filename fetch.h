@@ -3,17 +3,43 @@
 #ifndef FETCH_H
 #define FETCH_H
 
+#include <bsd/string.h>
 #include <curl/curl.h>
 #include <err.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "defs.h"
+#include "netlog.h"
+#include "store.h"
+#include "trace.h"
+#include "util.h"
+
+/* Request priority classes, most urgent first */
+enum fetchclasses {FC_INTERACTIVE, FC_PLAYBACK, FC_PREFETCH, FC_REPORT,
+    FC_MAX};
 
 struct buffer {
 	char	*data;
 	size_t	 pos;
 };
 
-int	fetch(char **, const char *);
+int		fetch(char **, const char *);
+void		fetch_admit(int);
+const char	*fetch_base(void);
+int		fetch_class(int);
+void		fetch_exit(void);
+CURL		*fetch_handle(void);
+int		fetch_init(struct info *);
+void		fetch_offline(void);
+int		fetch_online(void);
+void		fetch_release(int);
+int		fetch_resolve(char **);
+int		fetch_setbase(const char *);
+void		fetch_shape(size_t);
+int		fetch_stored(char **, const char *, const char *);
+int		fetch_wait(void);
 
 #endif
@@ -0,0 +1,155 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "hud.h"
+
+/* The HUD shows performance counters in the bottom rows of the body.
+ * Rates are taken over HUDINTERVAL milliseconds; between full redraws
+ * only the HUD rows are updated, so it can be left on.
+ */
+static pthread_mutex_t	hud_lock = PTHREAD_MUTEX_INITIALIZER;
+static int		hud_cache = -1;	/* VLC buffering in percent */
+
+/* Called by VLC on its event thread */
+void
+hud_buffering(const libvlc_event_t *ev, void *arg)
+{
+	(void)arg;
+
+	(void)pthread_mutex_lock(&hud_lock);
+	hud_cache = (int)ev->u.media_player_buffering.new_cache;
+	(void)pthread_mutex_unlock(&hud_lock);
+}
+
+/* Draw the HUD rows, the caller refreshes the screen */
+void
+hud_draw(struct info *data)
+{
+	char line[HUDROWS][128];
+	uint64_t p50, p99;
+	int i, y, cache;
+
+	if (data->hud == FALSE || LINES < HUDROWS + 8)
+		return;
+
+	cache = hud_vlcbuffering();
+	netlog_latency(&p50, &p99);
+
+	(void)snprintf(line[0], sizeof(line[0]),
+	    "frame %.2f ms  %llu redraws/s  %llu wakeups/s",
+	    data->hud_frametime / 1e6,
+	    (unsigned long long)data->hud_redrawrate,
+	    (unsigned long long)data->hud_wakeuprate);
+	(void)snprintf(line[1], sizeof(line[1]),
+	    "heap %llu KiB  %d requests  p50 %.1f ms  p99 %.1f ms",
+	    (unsigned long long)data->hud_heap, netlog_inflight(),
+	    p50 / 1e3, p99 / 1e3);
+	if (cache < 0)
+		(void)snprintf(line[2], sizeof(line[2]), "vlc buffer -");
+	else
+		(void)snprintf(line[2], sizeof(line[2]), "vlc buffer %d%%",
+		    cache);
+	if (data->stream != NULL)
+		(void)snprintf(line[2] + strlen(line[2]),
+		    sizeof(line[2]) - strlen(line[2]), "  stream %llu kbit/s",
+		    (unsigned long long)data->hud_bitrate);
+
+	y = LINES - 3 - HUDROWS;
+	(void)attron(A_REVERSE);
+	for (i = 0; i < HUDROWS; i++) {
+		(void)mvhline(y + i, 1, ' ', COLS - 2);
+		(void)mvprintw(y + i, 2, "%.*s", COLS - 4, line[i]);
+	}
+	(void)attroff(A_REVERSE);
+}
+
+/* VLC buffering in percent, -1 before the first event */
+int
+hud_vlcbuffering(void)
+{
+	int cache;
+
+	(void)pthread_mutex_lock(&hud_lock);
+	cache = hud_cache;
+	(void)pthread_mutex_unlock(&hud_lock);
+
+	return cache;
+}
+
+/* Record the duration of a full redraw in nanoseconds */
+void
+hud_frame(struct info *data, uint64_t ns)
+{
+	data->hud_frametime = ns;
+	data->hud_redraws++;
+}
+
+void
+hud_init(struct info *data)
+{
+	data->hud = FALSE;
+	data->hud_next = 0;
+	data->hud_frametime = 0;
+	data->hud_redraws = 0;
+	data->hud_wakeups = 0;
+	data->hud_redrawrate = 0;
+	data->hud_wakeuprate = 0;
+	data->hud_heap = 0;
+	data->hud_bytes = 0;
+	data->hud_bitrate = 0;
+}
+
+/* Milliseconds until the HUD needs to be updated */
+int
+hud_timeout(struct info *data)
+{
+	uint64_t now;
+
+	if (data->hud == FALSE)
+		return HALFDELAY * 100;
+	now = monotime();
+	if (now >= data->hud_next)
+		return 0;
+
+	return (int)((data->hud_next - now) / 1000000);
+}
+
+/* Take the rates of the past interval, returns TRUE if the HUD rows
+ * have to be drawn again.
+ */
+int
+hud_update(struct info *data)
+{
+	uint64_t now, elapsed, bytes;
+
+	if (data->hud == FALSE)
+		return FALSE;
+	now = monotime();
+	if (now < data->hud_next)
+		return FALSE;
+
+	elapsed = now - data->hud_next + HUDINTERVAL * 1000000ULL;
+	if (data->hud_next == 0)
+		elapsed = 0;
+	bytes = data->stream != NULL ? stream_bytes(data->stream) : 0;
+	if (elapsed > 0) {
+		data->hud_redrawrate = data->hud_redraws * 1000000000ULL /
+		    elapsed;
+		data->hud_wakeuprate = data->hud_wakeups * 1000000000ULL /
+		    elapsed;
+		data->hud_bitrate = bytes < data->hud_bytes ? 0 :
+		    (bytes - data->hud_bytes) * 8 * 1000000ULL / elapsed;
+	}
+	data->hud_redraws = 0;
+	data->hud_wakeups = 0;
+	data->hud_bytes = bytes;
+	data->hud_heap = heapinuse() / 1024;
+	data->hud_next = now + HUDINTERVAL * 1000000ULL;
+
+	return TRUE;
+}
+
+void
+hud_wakeup(struct info *data)
+{
+	data->hud_wakeups++;
+}
@@ -0,0 +1,27 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef HUD_H
+#define HUD_H
+
+#include <malloc.h>
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vlc/vlc.h>
+#include "defs.h"
+#include "netlog.h"
+#include "stream.h"
+#include "util.h"
+
+void	hud_buffering(const libvlc_event_t *, void *);
+void	hud_draw(struct info *);
+void	hud_frame(struct info *, uint64_t);
+void	hud_init(struct info *);
+int	hud_timeout(struct info *);
+int	hud_update(struct info *);
+int	hud_vlcbuffering(void);
+void	hud_wakeup(struct info *);
+
+#endif
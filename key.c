@@ -4,12 +4,16 @@
 
 static void	key_handleplay(struct info *, int, wint_t);
 static void	key_handlesearch(struct info *, int, wint_t);
+static void	key_handlefilter(struct info *, int, wint_t);
 static void	key_handleselect(struct info *, int, wint_t);
 static void	key_handlestart(struct info *, int, wint_t);
+static void	key_hud(struct info *);
+static void	key_netlog(struct info *);
 
 void
 key_handle(struct info *data)
 {
+	int delay, hudonly;
 	int errn;
 	int step;
 	wint_t c;
@@ -17,11 +21,32 @@ key_handle(struct info *data)
 	if (data == NULL)
 		return;
 
-	/* Get key */
+	/* Get key, waking up in time to expire notifications, to start
+	 * prefetching, to draw DJ names and to update the HUD.  A wakeup
+	 * that is only for the HUD does not redraw the rest of the screen.
+	 */
+	delay = notify_timeout(data);
+	if (prefetch_timeout(data) < delay)
+		delay = prefetch_timeout(data);
+	if (enrich_timeout(data) < delay)
+		delay = enrich_timeout(data);
+	hudonly = FALSE;
+	if (hud_timeout(data) < delay) {
+		delay = hud_timeout(data);
+		hudonly = TRUE;
+	}
+	(void)timeout(delay);
 	errn = get_wch(&c);
+	hud_wakeup(data);
+	if (errn != ERR)
+		trace_event(TR_KEY, (uint32_t)c, (uint64_t)errn);
 
-	if (errn == ERR)
+	if (errn == ERR) {
+		if (hudonly == FALSE)
+			data->dirty = TRUE;
 		return;
+	}
+	data->dirty = TRUE;
 	if (c == KEY_RESIZE) {
 		data->scroll = 0;
 		draw_redraw(data);
@@ -60,6 +85,8 @@ key_handlestart(struct info *data, int errn, wint_t c)
 	switch (c) {
 	case 'q':	data->quit = TRUE; break;
 	case 's':	search_init(data); break;
+	case 'i':	key_hud(data); break;
+	case 'L':	key_netlog(data); break;
 	default:	break;
 	}
 }
@@ -75,6 +102,8 @@ key_handleplay(struct info *data, int errn, wint_t c)
 	case 'n':	play_skip(data); break;
 	case 'p':	play_togglepause(data); break;
 	case 'N':	play_nextmix(data); break;
+	case 'i':	key_hud(data); break;
+	case 'L':	key_netlog(data); break;
 	default:	break;
 	}
 }
@@ -98,6 +127,7 @@ key_handlesearch(struct info *data, int errn, wint_t c)
 		case L'\n':		/* FALLTHROUGH */
 		case L'\r':		search_search(data); break;
 		case 0x1b: /* ESC */	search_exit(data); break;
+		case L'\t':		search_complete(data); break;
 		case 127:		/* FALLTHROUGH */
 		case L'\b':		search_backspace(data); break;
 		default:		search_addchar(data, c); break;
@@ -108,9 +138,45 @@ key_handlesearch(struct info *data, int errn, wint_t c)
 	}
 }
 
+/* Typing the filter of the select view, the cursor still moves */
+static void
+key_handlefilter(struct info *data, int errn, wint_t c)
+{
+	switch (errn) {
+	case KEY_CODE_YES:
+		switch (c) {
+		case KEY_UP:		/* FALLTHROUGH */
+		case KEY_DOWN:		select_changepos(data, c); break;
+		case KEY_BACKSPACE:	select_filter(data, L'\b'); break;
+		case KEY_ENTER:		select_filtermode(data, FALSE, FALSE);
+					break;
+		default:		break;
+		}
+		break;
+	case OK:
+		switch (c) {
+		case L'\r':		/* FALLTHROUGH */
+		case L'\n':		select_filtermode(data, FALSE, FALSE);
+					break;
+		case 0x1b: /* ESC */	select_filtermode(data, FALSE, TRUE);
+					break;
+		case 127:		/* FALLTHROUGH */
+		case L'\b':		select_filter(data, L'\b'); break;
+		default:		select_filter(data, c); break;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 static void
 key_handleselect(struct info *data, int errn, wint_t c)
 {
+	if (data->filtering == TRUE) {
+		key_handlefilter(data, errn, c);
+		return;
+	}
 	switch (errn) {
 	case KEY_CODE_YES:
 		switch (c) {
@@ -125,6 +191,10 @@ key_handleselect(struct info *data, int errn, wint_t c)
 		case L'\r':		/* FALLTHROUGH */
 		case L'\n':		select_select(data); break;
 		case 0x1b: /* ESC */	select_exit(data); break;
+		case L'\t':		select_sort(data); break;
+		case L'/':		select_filtermode(data, TRUE, FALSE);
+					break;
+		case L'L':		key_netlog(data); break;
 		default:		break;
 		}
 		break;
@@ -132,3 +202,17 @@ key_handleselect(struct info *data, int errn, wint_t c)
 		break;
 	}
 }
+
+static void
+key_hud(struct info *data)
+{
+	data->hud = !data->hud;
+	data->hud_next = 0;
+}
+
+static void
+key_netlog(struct info *data)
+{
+	if (netlog_dump() == ERROR)
+		notify_push(data, "Could not write the network log");
+}
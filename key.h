@@ -7,9 +7,15 @@
 #include <wchar.h>
 #include "defs.h"
 #include "draw.h"
+#include "enrich.h"
+#include "hud.h"
+#include "netlog.h"
+#include "notify.h"
 #include "play.h"
+#include "prefetch.h"
 #include "search.h"
 #include "select.h"
+#include "trace.h"
 
 void key_handle(struct info *);
 
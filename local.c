@@ -0,0 +1,821 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "local.h"
+
+struct posting;
+
+static void	 local_adddoc(int, const char *, const char *, int);
+static int	 local_has(int);
+static void	 local_index(uint32_t);
+static void	 local_insert(int);
+static size_t	 local_intersect(uint32_t *, size_t, const uint32_t *,
+		    size_t);
+static int	 local_isword(char);
+static size_t	 local_list(uint32_t, const struct posting *, size_t,
+		    uint32_t **, size_t *);
+static int	 local_map(void);
+static int	 local_postcmp(const void *, const void *);
+static void	 local_push(uint32_t **, size_t *, size_t *, uint32_t);
+static void	 local_putvar(unsigned char **, size_t *, size_t *,
+		    uint32_t);
+static void	 local_sortdelta(void);
+static size_t	 local_terms(const char *, uint32_t **, size_t *);
+static int	 local_termcmp(const void *, const void *);
+static int	 local_verify(const char *, const char *);
+static const char *local_word(const char *, size_t *);
+static int	 local_write(void);
+static void	*local_writer(void *);
+
+/* A full-text index over every mix seen.  Mixes are appended to the
+ * log "docs" with their folded text and JSON object, a document is
+ * numbered by its position in the log.  The index file "terms" maps
+ * the trigrams of every word, and words of one or two bytes as they
+ * are, to posting lists of document numbers: ascending and delta
+ * encoded as variable length integers.  It is memory mapped and covers
+ * the first documents.  Later ones are indexed in memory and merged
+ * into a new index file on exit, and by a thread every LOCALDELTA
+ * mixes.
+ */
+struct dochdr {
+	int32_t		 id;
+	uint32_t	 keylen;	/* Folded text, with its NUL */
+	uint32_t	 jslen;		/* JSON, with its NUL */
+};
+struct termhdr {
+	char		 magic[4];
+	uint32_t	 version;
+	uint32_t	 ndocs;		/* Documents covered */
+	uint32_t	 nterms;
+	uint32_t	 size;		/* Bytes of posting lists */
+};
+struct term {
+	uint32_t	 term;
+	uint32_t	 count;		/* Documents in the posting list */
+	uint32_t	 offset;	/* Of the posting list */
+};
+struct posting {
+	uint32_t	 term;
+	uint32_t	 doc;
+};
+struct doc {
+	const char	*key;
+	const char	*js;
+	int		 owned;		/* Allocated, not in the log map */
+};
+
+static pthread_mutex_t	 local_lock = PTHREAD_MUTEX_INITIALIZER;
+static int		 local_enabled = FALSE;
+static char		 local_dir[PATH_MAX];
+
+/* The documents */
+static int		 log_fd = -1;
+static unsigned char	*log_map = NULL;	/* As it was opened */
+static size_t		 log_size = 0;
+static uint64_t		 log_bytes = 0;
+static struct doc	*docs = NULL;
+static uint32_t		 ndocs = 0;
+static size_t		 docs_cap = 0;
+static int		*ids = NULL;		/* Set of mix ids */
+static size_t		 ids_cap = 0;
+static size_t		 nids = 0;
+
+/* The index file and the postings not in it yet */
+static unsigned char	*term_map = NULL;
+static size_t		 term_size = 0;
+static const struct term *seg_list = NULL;
+static const unsigned char *seg_postings = NULL;
+static uint32_t		 seg_terms = 0;
+static uint32_t		 seg_size = 0;
+static uint32_t		 seg_docs = 0;
+static struct posting	*delta = NULL;
+static size_t		 ndelta = 0;
+static size_t		 delta_cap = 0;
+static int		 delta_sorted = TRUE;
+static pthread_t	 write_thread;
+static int		 write_pending = FALSE;	/* write_thread not joined */
+static int		 write_running = FALSE;
+
+static uint64_t		 local_queries = 0;
+static uint64_t		 local_qtime = 0;
+
+/* Index a mix, unless it was indexed before.  key is its folded text */
+void
+local_add(json_t *obj, int id, const char *key)
+{
+	struct dochdr h;
+	char *js, *k, *rec;
+	size_t len;
+
+	if (obj == NULL || id <= 0 || key == NULL)
+		return;
+
+	(void)pthread_mutex_lock(&local_lock);
+	if (local_enabled == FALSE || local_has(id) == TRUE)
+		goto done;
+	js = json_dumps(obj, JSON_COMPACT);
+	if (js == NULL)
+		goto done;
+
+	/* Append the document in one write */
+	h.id = id;
+	h.keylen = (uint32_t)strlen(key) + 1;
+	h.jslen = (uint32_t)strlen(js) + 1;
+	len = sizeof(h) + h.keylen + h.jslen;
+	rec = malloc(len);
+	if (rec == NULL)
+		err(1, NULL);
+	(void)memcpy(rec, &h, sizeof(h));
+	(void)memcpy(rec + sizeof(h), key, h.keylen);
+	(void)memcpy(rec + sizeof(h) + h.keylen, js, h.jslen);
+	if (write(log_fd, rec, len) != (ssize_t)len) {
+		free(rec);
+		free(js);
+		goto done;
+	}
+	free(rec);
+	log_bytes += len;
+
+	k = malloc(h.keylen);
+	if (k == NULL)
+		err(1, NULL);
+	(void)memcpy(k, key, h.keylen);
+	local_adddoc(id, k, js, TRUE);
+	local_index(ndocs - 1);
+	if (ndocs - seg_docs >= LOCALDELTA && write_running == FALSE) {
+		if (write_pending == TRUE)
+			(void)pthread_join(write_thread, NULL);
+		write_pending = FALSE;
+		if (pthread_create(&write_thread, NULL, local_writer,
+		    NULL) == 0) {
+			write_pending = TRUE;
+			write_running = TRUE;
+		}
+	}
+
+done:
+	(void)pthread_mutex_unlock(&local_lock);
+}
+
+void
+local_exit(void)
+{
+	uint32_t i;
+	int enabled;
+
+	/* Nothing is added once disabled, so no thread starts a write */
+	(void)pthread_mutex_lock(&local_lock);
+	enabled = local_enabled;
+	local_enabled = FALSE;
+	(void)pthread_mutex_unlock(&local_lock);
+	if (write_pending == TRUE)
+		(void)pthread_join(write_thread, NULL);
+	write_pending = FALSE;
+	if (enabled == TRUE && ndocs > seg_docs)
+		(void)local_write();
+
+	(void)pthread_mutex_lock(&local_lock);
+	if (term_map != NULL)
+		(void)munmap(term_map, term_size);
+	term_map = NULL;
+	term_size = 0;
+	seg_terms = 0;
+	seg_size = 0;
+	seg_docs = 0;
+	if (log_map != NULL)
+		(void)munmap(log_map, log_size);
+	log_map = NULL;
+	if (log_fd != -1)
+		(void)close(log_fd);
+	log_fd = -1;
+	for (i = 0; i < ndocs; i++) {
+		if (docs[i].owned == TRUE) {
+			free((char *)docs[i].key);
+			free((char *)docs[i].js);
+		}
+	}
+	free(docs);
+	docs = NULL;
+	ndocs = 0;
+	free(ids);
+	ids = NULL;
+	free(delta);
+	delta = NULL;
+	ndelta = 0;
+	delta_cap = 0;
+	(void)pthread_mutex_unlock(&local_lock);
+}
+
+int
+local_init(void)
+{
+	char path[PATH_MAX];
+	struct stat sb;
+	struct dochdr h;
+	uint64_t off;
+	uint32_t i;
+	void *map;
+	int n;
+
+	if (datadir(local_dir, sizeof(local_dir), "index") == ERROR)
+		return ERROR;
+	n = snprintf(path, sizeof(path), "%s/docs", local_dir);
+	if (n < 0 || (size_t)n >= sizeof(path))
+		return ERROR;
+	log_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (log_fd == -1)
+		return ERROR;
+	if (fstat(log_fd, &sb) == -1)
+		goto error;
+	if (sb.st_size > 0) {
+		map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE,
+		    log_fd, 0);
+		if (map == MAP_FAILED)
+			goto error;
+		log_map = (unsigned char *)map;
+		log_size = (size_t)sb.st_size;
+	}
+
+	/* Number the documents, a partly written one at the end is cut */
+	(void)pthread_mutex_lock(&local_lock);
+	for (off = 0; off + sizeof(h) <= log_size;
+	    off += sizeof(h) + h.keylen + h.jslen) {
+		(void)memcpy(&h, log_map + off, sizeof(h));
+		if (h.keylen == 0 || h.jslen == 0 ||
+		    off + sizeof(h) + h.keylen + h.jslen > log_size ||
+		    log_map[off + sizeof(h) + h.keylen - 1] != '\0' ||
+		    log_map[off + sizeof(h) + h.keylen + h.jslen - 1] != '\0')
+			break;
+		local_adddoc(h.id, (const char *)log_map + off + sizeof(h),
+		    (const char *)log_map + off + sizeof(h) + h.keylen, FALSE);
+	}
+	if (off < log_size)
+		(void)ftruncate(log_fd, (off_t)off);
+	log_bytes = off;
+
+	/* Index what the index file does not cover */
+	(void)local_map();
+	for (i = seg_docs; i < ndocs; i++)
+		local_index(i);
+	local_enabled = TRUE;
+	(void)pthread_mutex_unlock(&local_lock);
+
+	return SUCCESS;
+
+error:
+	(void)close(log_fd);
+	log_fd = -1;
+
+	return ERROR;
+}
+
+/* Find the mixes of which the text contains every word of q, most
+ * recently seen first.  The result looks like a search response.
+ */
+json_t *
+local_query(const char *q)
+{
+	char *fq;
+	uint32_t *terms, *cand, *list;
+	size_t nterms, ncand, nlist, tcap, ccap, lcap, i;
+	uint32_t doc;
+	uint64_t start;
+	json_t *root, *mix_set, *mixes, *mix;
+
+	start = monotime();
+	fq = foldstr(q);
+	terms = NULL;
+	cand = NULL;
+	list = NULL;
+	tcap = ccap = lcap = 0;
+	mixes = json_array();
+	if (mixes == NULL)
+		err(1, NULL);
+
+	(void)pthread_mutex_lock(&local_lock);
+	if (local_enabled == FALSE) {
+		(void)pthread_mutex_unlock(&local_lock);
+		free(fq);
+		json_decref(mixes);
+		return NULL;
+	}
+
+	/* Candidates have every term of q, without terms every mix is */
+	nterms = local_terms(fq, &terms, &tcap);
+	ncand = ndocs;
+	local_sortdelta();
+	if (nterms > 0) {
+		ncand = local_list(terms[0], delta, ndelta, &cand, &ccap);
+		for (i = 1; i < nterms && ncand > 0; i++) {
+			nlist = local_list(terms[i], delta, ndelta, &list,
+			    &lcap);
+			ncand = local_intersect(cand, ncand, list, nlist);
+		}
+	}
+
+	/* Trigrams may be apart in the text, check for the words */
+	for (i = ncand; i-- > 0 && json_array_size(mixes) < LOCALRESULTS;) {
+		doc = nterms > 0 ? cand[i] : (uint32_t)i;
+		if (local_verify(docs[doc].key, fq) == FALSE)
+			continue;
+		mix = json_loads(docs[doc].js, 0, NULL);
+		if (mix != NULL)
+			(void)json_array_append_new(mixes, mix);
+	}
+	local_queries++;
+	local_qtime = monotime() - start;
+	(void)pthread_mutex_unlock(&local_lock);
+
+	free(fq);
+	free(terms);
+	free(cand);
+	free(list);
+
+	root = json_object();
+	mix_set = json_object();
+	if (root == NULL || mix_set == NULL)
+		err(1, NULL);
+	(void)json_object_set_new(mix_set, "mixes", mixes);
+	(void)json_object_set_new(root, "mix_set", mix_set);
+	(void)json_object_set_new(root, "status", json_string("200 OK"));
+
+	return root;
+}
+
+void
+local_stats(struct localstats *st)
+{
+	(void)pthread_mutex_lock(&local_lock);
+	st->docs = ndocs;
+	st->bytes = log_bytes + term_size;
+	st->queries = local_queries;
+	st->query_time = local_qtime;
+	(void)pthread_mutex_unlock(&local_lock);
+}
+
+static void
+local_adddoc(int id, const char *key, const char *js, int owned)
+{
+	if (ndocs == docs_cap) {
+		docs_cap = docs_cap > 0 ? docs_cap * 2 : 256;
+		docs = realloc(docs, docs_cap * sizeof(struct doc));
+		if (docs == NULL)
+			err(1, NULL);
+	}
+	docs[ndocs].key = key;
+	docs[ndocs].js = js;
+	docs[ndocs].owned = owned;
+	ndocs++;
+	if (id > 0)
+		local_insert(id);
+}
+
+static int
+local_has(int id)
+{
+	size_t i;
+
+	if (ids_cap == 0)
+		return FALSE;
+	for (i = ((size_t)id * 2654435761U) & (ids_cap - 1); ids[i] != 0;
+	    i = (i + 1) & (ids_cap - 1)) {
+		if (ids[i] == id)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Add the terms of a document to the postings in memory */
+static void
+local_index(uint32_t doc)
+{
+	uint32_t *terms;
+	size_t n, cap, i;
+
+	terms = NULL;
+	cap = 0;
+	n = local_terms(docs[doc].key, &terms, &cap);
+	if (ndelta + n > delta_cap) {
+		while (ndelta + n > delta_cap)
+			delta_cap = delta_cap > 0 ? delta_cap * 2 : 4096;
+		delta = realloc(delta, delta_cap * sizeof(struct posting));
+		if (delta == NULL)
+			err(1, NULL);
+	}
+	for (i = 0; i < n; i++) {
+		delta[ndelta].term = terms[i];
+		delta[ndelta].doc = doc;
+		ndelta++;
+	}
+	if (n > 0)
+		delta_sorted = FALSE;
+	free(terms);
+}
+
+static void
+local_insert(int id)
+{
+	int *old;
+	size_t oldcap, i;
+
+	if (local_has(id) == TRUE)
+		return;
+	if ((nids + 1) * 2 > ids_cap) {
+		old = ids;
+		oldcap = ids_cap;
+		ids_cap = ids_cap > 0 ? ids_cap * 2 : 1024;
+		ids = calloc(ids_cap, sizeof(int));
+		if (ids == NULL)
+			err(1, NULL);
+		nids = 0;
+		for (i = 0; i < oldcap; i++) {
+			if (old[i] != 0)
+				local_insert(old[i]);
+		}
+		free(old);
+	}
+	for (i = ((size_t)id * 2654435761U) & (ids_cap - 1); ids[i] != 0;
+	    i = (i + 1) & (ids_cap - 1))
+		;
+	ids[i] = id;
+	nids++;
+}
+
+/* Keep the documents of a that are in b, both ascending */
+static size_t
+local_intersect(uint32_t *a, size_t na, const uint32_t *b, size_t nb)
+{
+	size_t i, j, n;
+
+	for (i = 0, j = 0, n = 0; i < na && j < nb;) {
+		if (a[i] < b[j])
+			i++;
+		else if (a[i] > b[j])
+			j++;
+		else {
+			a[n++] = a[i++];
+			j++;
+		}
+	}
+
+	return n;
+}
+
+static int
+local_isword(char c)
+{
+	return isalnum((unsigned char)c) || (unsigned char)c >= 0x80;
+}
+
+/* The documents with a term in the index file and in the sorted
+ * postings d, ascending
+ */
+static size_t
+local_list(uint32_t term, const struct posting *d, size_t nd,
+    uint32_t **list, size_t *cap)
+{
+	const unsigned char *p, *end;
+	size_t lo, hi, mid, n;
+	uint32_t doc, v, i;
+	int shift;
+
+	n = 0;
+
+	/* In the index file */
+	lo = 0;
+	hi = seg_terms;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (seg_list[mid].term < term)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < seg_terms && seg_list[lo].term == term &&
+	    seg_list[lo].offset <= seg_size) {
+		p = seg_postings + seg_list[lo].offset;
+		end = seg_postings + seg_size;
+		for (doc = 0, i = 0; i < seg_list[lo].count; i++) {
+			for (v = 0, shift = 0; p < end && shift < 32;
+			    shift += 7) {
+				v |= (uint32_t)(*p & 0x7f) << shift;
+				if ((*p++ & 0x80) == 0)
+					break;
+			}
+			doc += v;
+			if (doc >= seg_docs)
+				break;
+			local_push(list, cap, &n, doc);
+		}
+	}
+
+	/* In memory, all of them after the ones in the file */
+	lo = 0;
+	hi = nd;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (d[mid].term < term)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < nd && d[lo].term == term; lo++)
+		local_push(list, cap, &n, d[lo].doc);
+
+	return n;
+}
+
+/* Map the index file in place of the mapped one, if it is valid for
+ * the documents
+ */
+static int
+local_map(void)
+{
+	char path[PATH_MAX];
+	struct stat sb;
+	struct termhdr hdr;
+	void *map;
+	int fd, n;
+
+	n = snprintf(path, sizeof(path), "%s/terms", local_dir);
+	if (n < 0 || (size_t)n >= sizeof(path))
+		return ERROR;
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return ERROR;
+	if (fstat(fd, &sb) == -1 || (size_t)sb.st_size < sizeof(hdr)) {
+		(void)close(fd);
+		return ERROR;
+	}
+	map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	(void)close(fd);
+	if (map == MAP_FAILED)
+		return ERROR;
+	(void)memcpy(&hdr, map, sizeof(hdr));
+	if (memcmp(hdr.magic, LOCALMAGIC, sizeof(hdr.magic)) != 0 ||
+	    hdr.version != LOCALVERSION || hdr.ndocs > ndocs ||
+	    sizeof(hdr) + (uint64_t)hdr.nterms * sizeof(struct term) +
+	    hdr.size != (uint64_t)sb.st_size) {
+		(void)munmap(map, (size_t)sb.st_size);
+		return ERROR;
+	}
+
+	if (term_map != NULL)
+		(void)munmap(term_map, term_size);
+	term_map = (unsigned char *)map;
+	term_size = (size_t)sb.st_size;
+	seg_list = (const struct term *)(term_map + sizeof(hdr));
+	seg_postings = term_map + sizeof(hdr) +
+	    hdr.nterms * sizeof(struct term);
+	seg_terms = hdr.nterms;
+	seg_size = hdr.size;
+	seg_docs = hdr.ndocs;
+
+	return SUCCESS;
+}
+
+static int
+local_postcmp(const void *a, const void *b)
+{
+	const struct posting *x, *y;
+
+	x = (const struct posting *)a;
+	y = (const struct posting *)b;
+	if (x->term != y->term)
+		return x->term < y->term ? -1 : 1;
+	if (x->doc != y->doc)
+		return x->doc < y->doc ? -1 : 1;
+
+	return 0;
+}
+
+static void
+local_push(uint32_t **list, size_t *cap, size_t *n, uint32_t v)
+{
+	if (*n == *cap) {
+		*cap = *cap > 0 ? *cap * 2 : 64;
+		*list = realloc(*list, *cap * sizeof(uint32_t));
+		if (*list == NULL)
+			err(1, NULL);
+	}
+	(*list)[(*n)++] = v;
+}
+
+static void
+local_putvar(unsigned char **buf, size_t *cap, size_t *n, uint32_t v)
+{
+	do {
+		if (*n == *cap) {
+			*cap = *cap > 0 ? *cap * 2 : 4096;
+			*buf = realloc(*buf, *cap);
+			if (*buf == NULL)
+				err(1, NULL);
+		}
+		(*buf)[(*n)++] = (unsigned char)((v & 0x7f) |
+		    (v > 0x7f ? 0x80 : 0));
+		v >>= 7;
+	} while (v > 0);
+}
+
+static void
+local_sortdelta(void)
+{
+	if (delta_sorted == TRUE)
+		return;
+	qsort(delta, ndelta, sizeof(struct posting), local_postcmp);
+	delta_sorted = TRUE;
+}
+
+/* The distinct terms of a folded text: the trigrams of its words and
+ * words shorter than three bytes, tagged with their length.
+ */
+static size_t
+local_terms(const char *s, uint32_t **terms, size_t *cap)
+{
+	const unsigned char *w;
+	size_t len, i, n, u;
+
+	n = 0;
+	for (; (s = local_word(s, &len)) != NULL; s += len) {
+		w = (const unsigned char *)s;
+		if (len == 1)
+			local_push(terms, cap, &n, 1U << 24 | w[0]);
+		else if (len == 2)
+			local_push(terms, cap, &n,
+			    2U << 24 | (uint32_t)w[0] << 8 | w[1]);
+		for (i = 0; i + 3 <= len; i++)
+			local_push(terms, cap, &n, (uint32_t)w[i] << 16 |
+			    (uint32_t)w[i + 1] << 8 | w[i + 2]);
+	}
+	if (n == 0)
+		return 0;
+	qsort(*terms, n, sizeof(uint32_t), local_termcmp);
+	for (i = 1, u = 1; i < n; i++) {
+		if ((*terms)[i] != (*terms)[u - 1])
+			(*terms)[u++] = (*terms)[i];
+	}
+
+	return u;
+}
+
+static int
+local_termcmp(const void *a, const void *b)
+{
+	uint32_t x, y;
+
+	x = *(const uint32_t *)a;
+	y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Whether every word of q is in the text */
+static int
+local_verify(const char *text, const char *q)
+{
+	char word[256];
+	size_t len;
+
+	for (; (q = local_word(q, &len)) != NULL; q += len) {
+		if (len >= sizeof(word))
+			len = sizeof(word) - 1;
+		(void)memcpy(word, q, len);
+		word[len] = '\0';
+		if (strstr(text, word) == NULL)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* The next word of s and its length in bytes, or NULL */
+static const char *
+local_word(const char *s, size_t *len)
+{
+	while (*s != '\0' && local_isword(*s) == FALSE)
+		s++;
+	for (*len = 0; s[*len] != '\0' && local_isword(s[*len]); (*len)++)
+		;
+
+	return *len > 0 ? s : NULL;
+}
+
+/* Merge the postings in memory with those of the index file into a new
+ * index file, which then replaces the mapped one.  The merge works on a
+ * copy of the postings, so mixes are added and queried meanwhile.
+ * Only one write runs at a time and only it replaces the mapped file,
+ * which it can read without the lock.
+ */
+static int
+local_write(void)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	struct termhdr hdr;
+	struct term *out;
+	struct posting *snap;
+	unsigned char *post;
+	uint32_t *list;
+	uint32_t term, prev, covered;
+	size_t nout, npost, nsnap, pcap, lcap, n, i, j, k;
+	FILE *fp;
+	int len;
+
+	(void)pthread_mutex_lock(&local_lock);
+	covered = ndocs;
+	nsnap = ndelta;
+	snap = malloc((nsnap + 1) * sizeof(struct posting));
+	if (snap == NULL)
+		err(1, NULL);
+	if (nsnap > 0)
+		(void)memcpy(snap, delta, nsnap * sizeof(struct posting));
+	(void)pthread_mutex_unlock(&local_lock);
+	qsort(snap, nsnap, sizeof(struct posting), local_postcmp);
+
+	out = malloc((seg_terms + nsnap + 1) * sizeof(struct term));
+	if (out == NULL)
+		err(1, NULL);
+	post = NULL;
+	list = NULL;
+	nout = npost = pcap = lcap = 0;
+	for (i = 0, j = 0; i < seg_terms || j < nsnap; nout++) {
+		if (j == nsnap ||
+		    (i < seg_terms && seg_list[i].term <= snap[j].term))
+			term = seg_list[i].term;
+		else
+			term = snap[j].term;
+		n = local_list(term, snap, nsnap, &list, &lcap);
+		if (i < seg_terms && seg_list[i].term == term)
+			i++;
+		while (j < nsnap && snap[j].term == term)
+			j++;
+		out[nout].term = term;
+		out[nout].count = (uint32_t)n;
+		out[nout].offset = (uint32_t)npost;
+		for (k = 0, prev = 0; k < n; prev = list[k], k++)
+			local_putvar(&post, &pcap, &npost, list[k] - prev);
+	}
+	free(list);
+	free(snap);
+
+	(void)memcpy(hdr.magic, LOCALMAGIC, sizeof(hdr.magic));
+	hdr.version = LOCALVERSION;
+	hdr.ndocs = covered;
+	hdr.nterms = (uint32_t)nout;
+	hdr.size = (uint32_t)npost;
+	len = snprintf(path, sizeof(path), "%s/terms", local_dir);
+	if (len < 0 || (size_t)len >= sizeof(path))
+		goto error;
+	len = snprintf(tmp, sizeof(tmp), "%s/terms.tmp", local_dir);
+	if (len < 0 || (size_t)len >= sizeof(tmp))
+		goto error;
+	fp = fopen(tmp, "wb");
+	if (fp == NULL)
+		goto error;
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    (nout > 0 && fwrite(out, sizeof(struct term), nout, fp) != nout) ||
+	    (npost > 0 && fwrite(post, 1, npost, fp) != npost)) {
+		(void)fclose(fp);
+		(void)unlink(tmp);
+		goto error;
+	}
+	if (fclose(fp) == EOF || rename(tmp, path) == -1) {
+		(void)unlink(tmp);
+		goto error;
+	}
+	free(out);
+	free(post);
+
+	/* Once the new file is mapped, the postings it covers leave memory */
+	(void)pthread_mutex_lock(&local_lock);
+	if (local_map() == ERROR) {
+		(void)pthread_mutex_unlock(&local_lock);
+		return ERROR;
+	}
+	for (i = 0, n = 0; i < ndelta; i++) {
+		if (delta[i].doc >= covered)
+			delta[n++] = delta[i];
+	}
+	ndelta = n;
+	(void)pthread_mutex_unlock(&local_lock);
+
+	return SUCCESS;
+
+error:
+	free(out);
+	free(post);
+
+	return ERROR;
+}
+
+static void *
+local_writer(void *arg)
+{
+	(void)arg;
+	(void)local_write();
+
+	(void)pthread_mutex_lock(&local_lock);
+	write_running = FALSE;
+	(void)pthread_mutex_unlock(&local_lock);
+
+	return NULL;
+}
@@ -0,0 +1,40 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef LOCAL_H
+#define LOCAL_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <ctype.h>
+#include <err.h>
+#include <fcntl.h>
+#include <jansson.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "defs.h"
+#include "string.h"
+#include "util.h"
+
+#define LOCALMAGIC	"8pix"
+#define LOCALVERSION	1
+
+struct localstats {
+	uint64_t	 docs;		/* Mixes indexed */
+	uint64_t	 bytes;		/* Size of the files */
+	uint64_t	 queries;
+	uint64_t	 query_time;	/* Of the last query in ns */
+};
+
+void	 local_add(json_t *, int, const char *);
+void	 local_exit(void);
+int	 local_init(void);
+json_t	*local_query(const char *);
+void	 local_stats(struct localstats *);
+
+#endif
@@ -6,6 +6,9 @@ static void		 checklocale(void);
 static void		 dochecks(struct info *);
 static struct info	*info_create(void);
 static void		 info_free(struct info *);
+static int		 number(const char *);
+static void		 printtimings(struct info *);
+static void		 usage(void);
 
 static void
 checklocale(void)
@@ -30,9 +33,30 @@ dochecks(struct info *data)
 		 */
 		if (play_isoverthirtymark(data) == TRUE)
 			report(data);
-		if (play_ended(data) == TRUE)
+		if (play_ended(data) == TRUE) {
+			bench_begin(BENCH_NEXT);
 			play_next(data);
+		}
+		prefetch_play(data);
+
+		/* The first audio ends selecting a mix or changing the
+		 * track, and the soak lasts from there.
+		 */
+		if ((bench_running(BENCH_PLAY) == TRUE ||
+		    bench_running(BENCH_NEXT) == TRUE) &&
+		    play_audible(data) == TRUE) {
+			bench_end(BENCH_PLAY);
+			bench_end(BENCH_NEXT);
+			bench_begin(BENCH_SOAK);
+		}
+	} else if (data->state == SELECT) {
+		prefetch_select(data);
+		if (enrich_poll(data) == TRUE)
+			data->dirty = TRUE;
 	}
+
+	/* Send the reports queued while offline */
+	report_flush(data);
 }
 
 static struct info *
@@ -48,14 +72,51 @@ info_create(void)
 	data->quit = FALSE;
 	data->state = START;
 
+	data->start = monotime();
+	memset(data->phase, 0, sizeof(data->phase));
+	data->timings = FALSE;
+	data->headless = FALSE;
+	data->vlc_full = FALSE;
+	data->audio = &audio_vlc;
+	data->audio_arg = NULL;
+	data->stream = NULL;
+	data->stream_size = STREAMBUF * 1024;
+	data->stream_mmap = FALSE;
+	data->cache_size = (uint64_t)CACHESIZE * 1024 * 1024;
+
 	data->playtoken = NULL;
+	(void)pthread_mutex_init(&data->token_lock, NULL);
+	(void)pthread_cond_init(&data->token_cond, NULL);
+	data->token_busy = FALSE;
+	data->reports_queued = TRUE;	/* Check the queue of a previous run */
 	data->m = NULL;
 	data->mlist = NULL;
+	data->view = NULL;
+	data->view_size = 0;
+	data->sort = SORT_SERVER;
+	data->filtering = FALSE;
+	data->filter_len = 0;
 
 	data->search_str = NULL;
 	data->slist_head = NULL;
+	data->suggest_count = 0;
+	data->suggest_skip = 0;
+	data->enrich_seen = 0;
+
+	data->notice_count = 0;
+	data->replay = NULL;
+
+	data->zone = 1;
+	data->zone_device = NULL;
+	data->zone_next = NULL;
+	data->vlc_shared = NULL;
+	memset(&data->zone_st, 0, sizeof(data->zone_st));
+
+	prefetch_init(data);
+	hud_init(data);
 
 	data->scroll = 0;
+	data->dirty = TRUE;
 
 	return data;
 }
@@ -64,32 +125,305 @@ static void
 info_free(struct info *data)
 {
 	free(data->playtoken);
+	(void)pthread_mutex_destroy(&data->token_lock);
+	(void)pthread_cond_destroy(&data->token_cond);
 	mix_free(data->m);
 	free(data->search_str);
 	searchstr_clear(data);
 	free(data);
 }
 
+static void
+printtimings(struct info *data)
+{
+	const char *name[PHASE_MAX] = {"locale", "ncurses", "first frame",
+	    "network", "vlc"};
+	int i;
+
+	for (i = 0; i < PHASE_MAX; i++) {
+		if (data->phase[i] == 0)
+			(void)printf("%-12s failed\n", name[i]);
+		else
+			(void)printf("%-12s %8.3f ms\n", name[i],
+			    data->phase[i] / 1e6);
+	}
+}
+
+static int
+number(const char *arg)
+{
+	long n;
+	char *ep;
+
+	n = strtol(arg, &ep, 10);
+	if (*arg == '\0' || *ep != '\0' || n < 0 || n > INT_MAX)
+		errx(1, "invalid number: %s", arg);
+
+	return (int)n;
+}
+
+static void
+usage(void)
+{
+	(void)fprintf(stderr, "usage: 8p [-dfMt] [-A url] [-b size] "
+	    "[-c size] [-e jobs] [-o output]\n"
+	    "          [-S socket] [-z device ...]\n"
+	    "       8p -r script [-A url] [-g colsxlines] [-o output]\n"
+	    "       8p -s smartid [-j] [-N mixid] [-n count] [-p pages]\n");
+	exit(1);
+}
+
 int
-main(void)
+main(int argc, char *argv[])
 {
 	struct info *data;
+	struct info *z, *last;
+	int ch, state, json, next, count, pages, i, nzones, jobs;
+	int lines, cols, output;
+	long size;
+	char *ep, *sock, *smart_id, *script;
+	const char *devices[ZONEMAX];
+	char path[PATH_MAX];
+	const struct option longopts[] = {
+		{ "api",	required_argument,	NULL,	'A' },
+		{ "buffer",	required_argument,	NULL,	'b' },
+		{ "cache",	required_argument,	NULL,	'c' },
+		{ "daemon",	no_argument,		NULL,	'd' },
+		{ "enrich",	required_argument,	NULL,	'e' },
+		{ "full-vlc",	no_argument,		NULL,	'f' },
+		{ "geometry",	required_argument,	NULL,	'g' },
+		{ "json",	no_argument,		NULL,	'j' },
+		{ "mmap",	no_argument,		NULL,	'M' },
+		{ "count",	required_argument,	NULL,	'n' },
+		{ "output",	required_argument,	NULL,	'o' },
+		{ "next",	required_argument,	NULL,	'N' },
+		{ "pages",	required_argument,	NULL,	'p' },
+		{ "replay",	required_argument,	NULL,	'r' },
+		{ "search",	required_argument,	NULL,	's' },
+		{ "socket",	required_argument,	NULL,	'S' },
+		{ "timings",	no_argument,		NULL,	't' },
+		{ "zone",	required_argument,	NULL,	'z' },
+		{ NULL,		0,			NULL,	0 }
+	};
 
 	/* Initialize */
-	checklocale();
+	bench_start();
 	data = info_create();
-	draw_init();
-	play_init(data);
+	sock = NULL;
+	smart_id = NULL;
+	json = FALSE;
+	next = 0;
+	count = 0;
+	pages = 0;
+	nzones = 0;
+	jobs = ENRICHJOBS;
+	script = NULL;
+	lines = REPLAYLINES;
+	cols = REPLAYCOLS;
+	output = FALSE;
+	while ((ch = getopt_long(argc, argv,
+	    "A:b:c:de:fg:jMn:N:o:p:r:s:S:tz:", longopts, NULL)) != -1) {
+		switch (ch) {
+		case 'A':
+			if (fetch_setbase(optarg) == ERROR)
+				errx(1, "invalid url: %s", optarg);
+			break;
+		case 'b':
+			size = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || size < 0 ||
+			    size > 1024 * 1024)
+				errx(1, "invalid buffer size: %s", optarg);
+			data->stream_size = (size_t)size * 1024;
+			break;
+		case 'c':
+			size = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || size < 0 ||
+			    size > 1024 * 1024)
+				errx(1, "invalid cache size: %s", optarg);
+			data->cache_size = (uint64_t)size * 1024 * 1024;
+			break;
+		case 'd':	data->headless = TRUE; break;
+		case 'e':	jobs = number(optarg); break;
+		case 'f':	data->vlc_full = TRUE; break;
+		case 'g':
+			size = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != 'x' || size < 1 ||
+			    size > 1000)
+				errx(1, "invalid geometry: %s", optarg);
+			cols = (int)size;
+			size = strtol(ep + 1, &ep, 10);
+			if (*ep != '\0' || size < 1 || size > 1000)
+				errx(1, "invalid geometry: %s", optarg);
+			lines = (int)size;
+			break;
+		case 'j':	json = TRUE; break;
+		case 'M':	data->stream_mmap = TRUE; break;
+		case 'n':	count = number(optarg); break;
+		case 'N':	next = number(optarg); break;
+		case 'o':
+			data->audio = audio_find(optarg, &data->audio_arg);
+			if (data->audio == NULL)
+				errx(1, "invalid output: %s", optarg);
+			output = TRUE;
+			break;
+		case 'p':	pages = number(optarg); break;
+		case 'r':	script = optarg; break;
+		case 's':	smart_id = optarg; break;
+		case 'S':	sock = optarg; break;
+		case 't':	data->timings = TRUE; break;
+		case 'z':
+			if (nzones == ZONEMAX)
+				errx(1, "at most %d zones", ZONEMAX);
+			devices[nzones++] = strcmp(optarg, "default") == 0 ?
+			    NULL : optarg;
+			data->headless = TRUE;
+			break;
+		default:	usage();
+		}
+	}
+	checklocale();
+	trace_init();
+	data->phase[PHASE_LOCALE] = monotime() - data->start;
 
-	while (data->quit != TRUE) {
-		dochecks(data);
+	/* Batch mode prints its results and exits, without VLC */
+	if (smart_id != NULL) {
+		(void)fetch_init(data);
+		(void)store_init();
+		(void)local_init();
+		(void)complete_init();
+		ch = batch_run(data, smart_id, next, json, count, pages);
+		complete_exit();
+		local_exit();
+		fetch_exit();
+		info_free(data);
+		return ch == SUCCESS ? 0 : 1;
+	}
+
+	/* A replay takes its keys from a script and draws on a virtual
+	 * screen, measuring each phase of the scenario.  Unless given an
+	 * API and an output, it works only from stored responses and
+	 * plays nothing, so runs can be compared.
+	 */
+	if (script != NULL) {
+		bench_init();	/* Before any thread is created */
+		if (replay_init(data, script) == ERROR)
+			err(1, "%s", script);
+		data->headless = FALSE;
+		if (output == FALSE) {
+			data->audio = &audio_null;
+			data->audio_arg = NULL;
+			data->stream_size = 0;
+		}
+		nzones = 0;
+	}
+
+	/* Daemon mode is controlled through a socket instead of keys */
+	if (data->headless == TRUE) {
+		if (sock == NULL) {
+			if (ctl_path(path, sizeof(path)) == ERROR)
+				errx(1, "no path for the control socket");
+			sock = path;
+		}
+		if (ctl_init(sock) == ERROR)
+			err(1, "%s", sock);
+	}
+
+	/* Every further zone plays a session of its own, sharing VLC, the
+	 * fetch session, the caches and the main loop with the first.
+	 */
+	if (nzones > 0)
+		data->zone_device = devices[0];
+	for (i = 1, last = data; i < nzones; i++, last = z) {
+		z = info_create();
+		z->headless = TRUE;
+		z->stream_size = data->stream_size;
+		z->stream_mmap = data->stream_mmap;
+		z->audio = data->audio;
+		z->audio_arg = data->audio_arg;
+		z->zone = i + 1;
+		z->zone_device = devices[i];
+		z->vlc_shared = data;
+		last->zone_next = z;
+	}
+
+	/* Network and VLC are set up in the background while the first
+	 * frame is drawn.  Callers wait for them with fetch_wait() and
+	 * play_wait().
+	 */
+	if (data->replay != NULL && strcmp(fetch_base(), APIBASE) == 0)
+		fetch_offline();
+	(void)fetch_init(data);
+	(void)play_init(data);
+	if (data->headless == FALSE) {
+		if (data->replay != NULL)
+			draw_init(lines, cols);
+		else
+			draw_init(0, 0);
+		data->phase[PHASE_DRAW] = monotime() - data->start;
 		draw_redraw(data);
+		data->phase[PHASE_FRAME] = monotime() - data->start;
+		bench_end(BENCH_STARTUP);
+	}
+	(void)cache_init(data->cache_size);
+	(void)store_init();
+	(void)local_init();
+	(void)complete_init();
+	(void)enrich_init(jobs);
+	if (script == NULL)
+		(void)status_init();	/* Replays leave it to the player */
+
+	state = data->state;
+	while (data->quit != TRUE) {
+		for (z = data; z != NULL; z = z->zone_next)
+			dochecks(z);
+		if (data->state != state) {
+			trace_event(TR_STATE, (uint32_t)data->state,
+			    (uint64_t)state);
+			state = data->state;
+		}
+		status_update(data);
+		if (data->headless == TRUE) {
+			ctl_handle(data);
+			continue;
+		}
+		if (notify_expire(data) == TRUE)
+			data->dirty = TRUE;
+		if (hud_update(data) == TRUE && data->dirty == FALSE)
+			draw_hud(data);
+		if (data->dirty == TRUE)
+			draw_redraw(data);
+		if (data->replay != NULL)
+			replay_step(data);
 		key_handle(data);
 	}
 
-	play_exit(data);
+	for (z = data; z != NULL; z = z->zone_next) {
+		prefetch_exit(z);
+		play_exit(z);
+	}
+	(void)netlog_dump();
+	cache_exit();
+	enrich_exit();
+	complete_exit();
+	local_exit();
+	fetch_exit();
+	status_exit();
+	if (data->headless == TRUE)
+		ctl_exit();
+	else
+		draw_exit();
+	ch = SUCCESS;
+	if (data->replay != NULL)
+		ch = replay_exit(data);
+	if (data->timings == TRUE)
+		printtimings(data);
+	while (data->zone_next != NULL) {
+		z = data->zone_next;
+		data->zone_next = z->zone_next;
+		info_free(z);
+	}
 	info_free(data);
-	draw_exit();
+	trace_dump();
 
-	return 0;
+	return ch == SUCCESS ? 0 : 1;
 }
@@ -4,14 +4,34 @@
 #define MAIN_H
 
 #include <err.h>
+#include <getopt.h>
+#include <limits.h>
 #include <locale.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "audio.h"
+#include "batch.h"
+#include "bench.h"
+#include "cache.h"
+#include "complete.h"
+#include "ctl.h"
 #include "defs.h"
 #include "draw.h"
+#include "enrich.h"
+#include "fetch.h"
+#include "hud.h"
 #include "key.h"
 #include "mix.h"
+#include "netlog.h"
+#include "notify.h"
 #include "play.h"
+#include "prefetch.h"
+#include "replay.h"
 #include "report.h"
+#include "status.h"
+#include "store.h"
+#include "trace.h"
+#include "util.h"
 
 #endif
@@ -7,7 +7,9 @@ mix_create(json_t *root)
 {
 	struct mix *m;
 	json_t *id, *name, *user_id, *description, *likes_count, *plays_count,
-	     *tags, *liked;
+	     *tracks_count, *tags, *liked, *login;
+	char *all, *p, *q;
+	char tag[COMPLETELEN];
 	size_t len;
 
 	if (root == NULL)
@@ -21,6 +23,8 @@ mix_create(json_t *root)
 	m->name = NULL;
 	m->description = NULL;
 	m->tags = NULL;
+	m->key = NULL;
+	m->tracks_count = 0;
 	m->track = NULL;
 
 	/* Set information from json object */
@@ -28,28 +32,24 @@ mix_create(json_t *root)
 	if (id != NULL)
 		m->id = json_integer_value(id);
 
+	/* Text is normalized once, here, not when it is drawn */
 	name = json_object_get(root, "name");
-	if (name != NULL) {
-		len = strlen(json_string_value(name)) + 1;
-		m->name = malloc(len * sizeof(char));
-		if (m->name == NULL)
-			err(1, NULL);
-		(void)strlcpy(m->name, json_string_value(name), len);
-	}
+	if (json_is_string(name))
+		m->name = normstr(json_string_value(name), FALSE);
 
 	user_id = json_object_get(root, "user_id");
 	if (user_id != NULL)
 		m->user_id = json_integer_value(user_id);
 
+	/* Responses that include the DJ save looking the name up */
+	login = json_object_get(json_object_get(root, "user"), "login");
+	if (user_id != NULL && json_is_string(login))
+		enrich_seed(m->user_id, json_string_value(login));
+
 	description = json_object_get(root, "description");
-	if (description != NULL) {
-		len = strlen(json_string_value(description)) + 1;
-		m->description = malloc(len * sizeof(char));
-		if (m->description == NULL)
-			err(1, NULL);
-		(void)strlcpy(m->description, json_string_value(description),
-		    len);
-	}
+	if (json_is_string(description))
+		m->description = normstr(json_string_value(description),
+		    TRUE);
 
 	likes_count = json_object_get(root, "likes_count");
 	if (likes_count != NULL)
@@ -59,21 +59,54 @@ mix_create(json_t *root)
 	if (plays_count != NULL)
 		m->plays_count = json_integer_value(plays_count);
 
+	tracks_count = json_object_get(root, "tracks_count");
+	if (tracks_count != NULL)
+		m->tracks_count = json_integer_value(tracks_count);
+
 	tags = json_object_get(root, "tag_list_cache");
-	if (tags != NULL) {
-		len = strlen(json_string_value(tags)) + 1;
-		m->tags = malloc(len * sizeof(char));
-		if (m->tags == NULL)
-			err(1, NULL);
-		(void)strlcpy(m->tags, json_string_value(tags), len);
+	if (json_is_string(tags)) {
+		m->tags = normstr(json_string_value(tags), FALSE);
+
+		/* The tags complete smart ids typed later */
+		for (p = m->tags; p != NULL; p = q != NULL ? q + 1 : NULL) {
+			q = strchr(p, ',');
+			len = q != NULL ? (size_t)(q - p) : strlen(p);
+			if (len >= sizeof(tag))
+				continue;
+			(void)memcpy(tag, p, len);
+			tag[len] = '\0';
+			complete_add("tags", tag);
+		}
 	}
 
 	liked = json_object_get(root, "liked_by_current_user");
 	if (liked != NULL)
 		m->liked = json_is_true(liked);
 
+	/* Fold the text the select view filters on once, here */
+	len = strlen(m->name != NULL ? m->name : "") + strlen("\n") +
+	    strlen(m->tags != NULL ? m->tags : "") + strlen("\n") +
+	    strlen(m->description != NULL ? m->description : "") + 1;
+	all = malloc(len * sizeof(char));
+	if (all == NULL)
+		err(1, NULL);
+	(void)snprintf(all, len, "%s\n%s\n%s",
+	    m->name != NULL ? m->name : "", m->tags != NULL ? m->tags : "",
+	    m->description != NULL ? m->description : "");
+	m->key = foldstr(all);
+	free(all);
+	text_init(&m->name_text, m->name != NULL ? m->name : "");
+	text_init(&m->description_text,
+	    m->description != NULL ? m->description : "");
+	text_init(&m->tags_text, m->tags != NULL ? m->tags : "");
+
+	/* Every mix seen can be found offline later */
+	if (id != NULL)
+		local_add(root, m->id, m->key);
+
 	/* Set default values */
 	m->finished = FALSE;
+	m->position = 0;
 	m->track_count = 0;
 	m->track = NULL;
 
@@ -91,19 +124,50 @@ mix_free(struct mix *m)
 	free(m->name);
 	free(m->description);
 	free(m->tags);
+	free(m->key);
+	text_free(&m->name_text);
+	text_free(&m->description_text);
+	text_free(&m->tags_text);
 	for (i = 0; i < m->track_count; i++)
 		track_free(m->track[i]);
 	free(m->track);
 	free(m);
 }
 
+/* Fetch track n of a mix.  Only the first track needs n, the server
+ * keeps track of the position in the mix, but the response is stored
+ * under n for offline use.  This does not touch any shared state, so it
+ * is also used by the prefetch threads.
+ */
+struct track *
+mix_fetchtrack(const char *playtoken, int mix_id, int n)
+{
+	struct apiargs args;
+	json_t *root, *set;
+	struct track *t;
+
+	/* A different request is needed for the first track to get the
+	 * mix started.  Without a play token only a stored response can
+	 * be used.
+	 */
+	memset(&args, 0, sizeof(args));
+	args.token = playtoken;
+	args.mix_id = mix_id;
+	args.n = n;
+	root = api_get(n == 0 ? API_PLAY : API_NEXT, &args, &set);
+	if (root == NULL)
+		return NULL;
+
+	/* Set up track */
+	t = track_create(set);
+	json_decref(root);
+
+	return t;
+}
+
 struct track *
 mix_nexttrack(struct info *data)
 {
-	char *js, *url;
-	size_t len;
-	int errn;
-	json_t *root, *set, *status;
 	struct track *t;
 
 	if (data == NULL)
@@ -111,86 +175,40 @@ mix_nexttrack(struct info *data)
 	if (data->m == NULL)
 		return NULL;
 
-	/* Initialize variables */
-	js = NULL;
-	url = NULL;
-	root = NULL;
-	set = NULL;
-	status = NULL;
-	errn = setplaytoken(data);
-	if (errn == ERROR)
-		goto error;
-
-	/* Set up url
-	 * A different url is needed for the first track to get
-	 * the mix started.
+	/* The first track may already have been fetched while the mix
+	 * was selected.
 	 */
+	t = NULL;
 	if (data->m->track_count == 0) {
-		len = strlen("http://8tracks.com/sets/") +
-		    strlen(data->playtoken) + strlen("/play?mix_id=") +
-		    intlen(data->m->id) + 1;
-		url = malloc(len * sizeof(char));
-		if (url == NULL)
-			err(1, NULL);
-		(void)snprintf(url, len,
-		    "http://8tracks.com/sets/%s/play?mix_id=%d",
-		    data->playtoken, data->m->id);
-	} else {
-		len = strlen("http://8tracks.com/sets/") +
-		    strlen(data->playtoken) + strlen("/next?mix_id=") +
-		    intlen(data->m->id) + 1;
-		url = malloc(len * sizeof(char));
-		if (url == NULL)
-			err(1, NULL);
-		(void)snprintf(url, len,
-		    "http://8tracks.com/sets/%s/next?mix_id=%d",
-		    data->playtoken, data->m->id);
+		t = prefetch_take(data, data->m->id);
+		if (t != NULL)
+			data->m->position = 1;
 	}
 
-	/* Retrieve json string */
-	js = malloc(1);
-	if (js == NULL)
-		err(1, NULL);
-	errn = fetch(&js, url);
-	if (errn == ERROR)
-		goto error;
-
-	/* Parse json string */
-	root = json_loads(js, 0, NULL);
-	if (root == NULL)
-		goto error;
-	status = json_object_get(root, "status");
-	if (strcmp(json_string_value(status), "200 OK") != 0)
-		goto error;
-	set = json_object_get(root, "set");
-	if (set == NULL)
-		goto error;
+	/* Offline the play token is not available and only the stored
+	 * tracks whose audio is in the disk cache can be played.
+	 */
+	while (t == NULL) {
+		(void)setplaytoken(data);
+		t = mix_fetchtrack(data->playtoken, data->m->id,
+		    data->m->position);
+		if (t == NULL)
+			return NULL;
+		data->m->position++;
+		if (fetch_online() == FALSE && cache_has(t->id) == FALSE &&
+		    t->last == FALSE) {
+			track_free(t);
+			t = NULL;
+		}
+	}
 
-	/* Set up track */
-	t = track_create(set);
-	if (t == NULL)
-		goto error;
+	/* Add track to the mix */
 	data->m->track_count++;
 	data->m->track = realloc(data->m->track,
 	    data->m->track_count * sizeof(struct track *));
 	if (data->m->track == NULL)
-		goto error;
+		err(1, NULL);
 	data->m->track[data->m->track_count-1] = t;
 
-	/* Cleanup */
-	free(url);
-	free(js);
-	json_decref(root);
-
 	return t;
-
-error:
-	if (js)
-		free(js);
-	if (url)
-		free(url);
-	if (root)
-		json_decref(root);
-
-	return NULL;
 }
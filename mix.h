@@ -8,14 +8,22 @@
 #include <jansson.h>
 #include <stdlib.h>
 #include <string.h>
+#include "api.h"
+#include "cache.h"
+#include "complete.h"
 #include "defs.h"
+#include "enrich.h"
 #include "fetch.h"
+#include "local.h"
+#include "prefetch.h"
+#include "store.h"
 #include "string.h"
 #include "track.h"
 #include "util.h"
 
 struct mix	*mix_create(json_t *);
 void		 mix_free(struct mix *);
+struct track	*mix_fetchtrack(const char *, int, int);
 struct track	*mix_nexttrack(struct info *);
 
 #endif
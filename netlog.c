@@ -0,0 +1,208 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "netlog.h"
+
+static int	netlog_cmp(const void *, const void *);
+static uint64_t	netlog_usec(CURL *, CURLINFO);
+
+/* Every API request is recorded in a ring of the last NETLOGSIZE
+ * requests, and its total time in a histogram per endpoint.  Bucket i
+ * counts requests that took from 2^i up to 2^(i+1) microseconds, the
+ * first and last buckets also take the values below and above.
+ */
+static pthread_mutex_t	 netlog_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct netreq	 netlog_ring[NETLOGSIZE];
+static uint64_t		 netlog_count = 0;
+static int		 netlog_active = 0;	/* Requests in flight */
+static uint64_t		 netlog_hist[EP_MAX][NETLOGBUCKETS];
+static const char	*netlog_names[EP_MAX] = {"token", "play", "next",
+			    "next_mix", "search", "report", "user", "other"};
+
+/* Append the recorded requests and histograms as JSON lines to the
+ * netlog file in the data directory.
+ */
+int
+netlog_dump(void)
+{
+	FILE *fp;
+	struct netreq *r;
+	char path[PATH_MAX];
+	uint64_t i, first;
+	int ep, b;
+
+	if (datadir(path, sizeof(path), "") == ERROR)
+		return ERROR;
+	(void)strlcat(path, "netlog", sizeof(path));
+	fp = fopen(path, "a");
+	if (fp == NULL)
+		return ERROR;
+
+	(void)pthread_mutex_lock(&netlog_lock);
+	(void)fprintf(fp, "{\"type\":\"dump\",\"time\":%lld,"
+	    "\"requests\":%llu}\n", (long long)time(NULL),
+	    (unsigned long long)netlog_count);
+	first = netlog_count > NETLOGSIZE ? netlog_count - NETLOGSIZE : 0;
+	for (i = first; i < netlog_count; i++) {
+		r = &netlog_ring[i % NETLOGSIZE];
+		(void)fprintf(fp, "{\"type\":\"request\",\"time\":%lld,"
+		    "\"endpoint\":\"%s\",\"result\":%d,\"status\":%ld,"
+		    "\"dns\":%llu,\"connect\":%llu,\"tls\":%llu,"
+		    "\"ttfb\":%llu,\"total\":%llu,\"bytes\":%llu}\n",
+		    (long long)r->when, netlog_names[r->endpoint], r->result,
+		    r->status, (unsigned long long)r->dns,
+		    (unsigned long long)r->connect,
+		    (unsigned long long)r->tls, (unsigned long long)r->ttfb,
+		    (unsigned long long)r->total,
+		    (unsigned long long)r->bytes);
+	}
+	for (ep = 0; ep < EP_MAX; ep++) {
+		(void)fprintf(fp, "{\"type\":\"histogram\",\"endpoint\":\"%s\","
+		    "\"buckets\":[", netlog_names[ep]);
+		for (b = 0; b < NETLOGBUCKETS; b++)
+			(void)fprintf(fp, "%s%llu", b == 0 ? "" : ",",
+			    (unsigned long long)netlog_hist[ep][b]);
+		(void)fprintf(fp, "]}\n");
+	}
+	(void)pthread_mutex_unlock(&netlog_lock);
+
+	return fclose(fp) == 0 ? SUCCESS : ERROR;
+}
+
+int
+netlog_endpoint(const char *url)
+{
+	if (strstr(url, "/report?") != NULL)
+		return EP_REPORT;
+	if (strstr(url, "/next_mix?") != NULL)
+		return EP_NEXTMIX;
+	if (strstr(url, "/next?") != NULL)
+		return EP_NEXT;
+	if (strstr(url, "/play?") != NULL)
+		return EP_PLAY;
+	if (strstr(url, "/sets/new") != NULL)
+		return EP_TOKEN;
+	if (strstr(url, "/mix_sets/") != NULL)
+		return EP_SEARCH;
+	if (strstr(url, "/users/") != NULL)
+		return EP_USER;
+
+	return EP_OTHER;
+}
+
+int
+netlog_inflight(void)
+{
+	int n;
+
+	(void)pthread_mutex_lock(&netlog_lock);
+	n = netlog_active;
+	(void)pthread_mutex_unlock(&netlog_lock);
+
+	return n;
+}
+
+/* Median and 99th percentile of the total time of the recent requests,
+ * in microseconds.
+ */
+void
+netlog_latency(uint64_t *p50, uint64_t *p99)
+{
+	uint64_t total[NETLOGSIZE];
+	size_t i, n;
+
+	(void)pthread_mutex_lock(&netlog_lock);
+	n = netlog_count < NETLOGSIZE ? (size_t)netlog_count : NETLOGSIZE;
+	for (i = 0; i < n; i++)
+		total[i] = netlog_ring[i].total;
+	(void)pthread_mutex_unlock(&netlog_lock);
+
+	*p50 = 0;
+	*p99 = 0;
+	if (n == 0)
+		return;
+	qsort(total, n, sizeof(total[0]), netlog_cmp);
+	*p50 = total[(n - 1) / 2];
+	*p99 = total[(n - 1) * 99 / 100];
+}
+
+/* Count a request as in flight until netlog_record() */
+void
+netlog_start(void)
+{
+	(void)pthread_mutex_lock(&netlog_lock);
+	netlog_active++;
+	(void)pthread_mutex_unlock(&netlog_lock);
+}
+
+/* Record a finished request from the timing info of its handle */
+void
+netlog_record(CURL *curl, int endpoint, int result)
+{
+	struct netreq r;
+	curl_off_t bytes;
+	uint64_t total, connect, tls, start, end;
+	int b;
+
+	memset(&r, 0, sizeof(r));
+	r.when = time(NULL);
+	r.endpoint = endpoint;
+	r.result = result;
+	if (curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &r.status) !=
+	    CURLE_OK)
+		r.status = 0;
+	r.total = netlog_usec(curl, CURLINFO_TOTAL_TIME_T);
+
+	/* curl reports when each phase ended, counted from the start, and
+	 * 0 for the phases a reused connection or plain http skips.
+	 */
+	r.dns = netlog_usec(curl, CURLINFO_NAMELOOKUP_TIME_T);
+	connect = netlog_usec(curl, CURLINFO_CONNECT_TIME_T);
+	tls = netlog_usec(curl, CURLINFO_APPCONNECT_TIME_T);
+	start = netlog_usec(curl, CURLINFO_STARTTRANSFER_TIME_T);
+	end = r.dns;
+	if (connect > end) {
+		r.connect = connect - end;
+		end = connect;
+	}
+	if (tls > end) {
+		r.tls = tls - end;
+		end = tls;
+	}
+	if (start > end)
+		r.ttfb = start - end;
+	if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes) ==
+	    CURLE_OK && bytes > 0)
+		r.bytes = (uint64_t)bytes;
+
+	for (b = 0, total = r.total; total > 1 && b < NETLOGBUCKETS - 1; b++)
+		total >>= 1;
+
+	(void)pthread_mutex_lock(&netlog_lock);
+	netlog_ring[netlog_count % NETLOGSIZE] = r;
+	netlog_count++;
+	netlog_active--;
+	netlog_hist[endpoint][b]++;
+	(void)pthread_mutex_unlock(&netlog_lock);
+}
+
+static int
+netlog_cmp(const void *a, const void *b)
+{
+	uint64_t x, y;
+
+	x = *(const uint64_t *)a;
+	y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t
+netlog_usec(CURL *curl, CURLINFO info)
+{
+	curl_off_t t;
+
+	if (curl_easy_getinfo(curl, info, &t) != CURLE_OK || t < 0)
+		return 0;
+
+	return (uint64_t)t;
+}
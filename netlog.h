@@ -0,0 +1,42 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef NETLOG_H
+#define NETLOG_H
+
+#include <bsd/string.h>
+#include <curl/curl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "defs.h"
+#include "util.h"
+
+/* API endpoint classes, derived from the request url */
+enum endpoints {EP_TOKEN, EP_PLAY, EP_NEXT, EP_NEXTMIX, EP_SEARCH, EP_REPORT,
+    EP_USER, EP_OTHER, EP_MAX};
+
+struct netreq {
+	time_t		 when;
+	int		 endpoint;
+	int		 result;	/* CURLcode */
+	long		 status;	/* HTTP status */
+	uint64_t	 dns;		/* Microseconds spent in each phase */
+	uint64_t	 connect;
+	uint64_t	 tls;
+	uint64_t	 ttfb;		/* From the request to the first byte */
+	uint64_t	 total;		/* Microseconds since the start */
+	uint64_t	 bytes;
+};
+
+int	netlog_dump(void);
+int	netlog_endpoint(const char *);
+int	netlog_inflight(void);
+void	netlog_latency(uint64_t *, uint64_t *);
+void	netlog_record(CURL *, int, int);
+void	netlog_start(void);
+
+#endif
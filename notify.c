@@ -0,0 +1,87 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "notify.h"
+
+/* Queue a message for the footer.  A message that is already queued is
+ * not added again, its repeat count is raised and its time refreshed.
+ */
+void
+notify_push(struct info *data, const char *msg)
+{
+	struct notice *n;
+	int i;
+
+	if (data == NULL || msg == NULL)
+		return;
+
+	for (i = 0; i < data->notice_count; i++) {
+		n = &data->notice[i];
+		if (strcmp(n->msg, msg) == 0) {
+			n->count++;
+			n->expire = monotime() + NOTIFYTIME * 1000000ULL;
+			return;
+		}
+	}
+
+	/* Drop the oldest message when the queue is full */
+	if (data->notice_count == NOTIFYMAX) {
+		memmove(&data->notice[0], &data->notice[1],
+		    (NOTIFYMAX - 1) * sizeof(struct notice));
+		data->notice_count--;
+	}
+
+	n = &data->notice[data->notice_count++];
+	(void)strlcpy(n->msg, msg, sizeof(n->msg));
+	n->count = 1;
+	n->expire = monotime() + NOTIFYTIME * 1000000ULL;
+}
+
+/* Remove expired messages, returns TRUE if any were removed */
+int
+notify_expire(struct info *data)
+{
+	uint64_t now;
+	int i, j;
+
+	now = monotime();
+	for (i = 0, j = 0; i < data->notice_count; i++) {
+		if (data->notice[i].expire > now)
+			data->notice[j++] = data->notice[i];
+	}
+	if (j == data->notice_count)
+		return FALSE;
+	data->notice_count = j;
+
+	return TRUE;
+}
+
+/* The most recent message, or NULL if there is nothing to show */
+struct notice *
+notify_current(struct info *data)
+{
+	if (data->notice_count == 0)
+		return NULL;
+
+	return &data->notice[data->notice_count-1];
+}
+
+/* Milliseconds the event loop may wait for input before the next
+ * message expires.
+ */
+int
+notify_timeout(struct info *data)
+{
+	uint64_t now, next;
+	int i;
+
+	next = HALFDELAY * 100;
+	now = monotime();
+	for (i = 0; i < data->notice_count; i++) {
+		if (data->notice[i].expire <= now)
+			return 0;
+		if ((data->notice[i].expire - now) / 1000000 < next)
+			next = (data->notice[i].expire - now) / 1000000 + 1;
+	}
+
+	return (int)next;
+}
@@ -0,0 +1,17 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include <bsd/string.h>
+#include <stdint.h>
+#include <string.h>
+#include "defs.h"
+#include "util.h"
+
+struct notice	*notify_current(struct info *);
+int		 notify_expire(struct info *);
+void		 notify_push(struct info *, const char *);
+int		 notify_timeout(struct info *);
+
+#endif
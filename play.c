@@ -2,44 +2,96 @@
 
 #include "play.h"
 
+static void	*play_initaudio(void *);
+static int	 play_ready(struct info *);
+static void	 play_stop(struct info *);
+
 void
 play_exit(struct info *data)
 {
-	libvlc_media_player_release(data->vlc_mp);
-	libvlc_release(data->vlc_inst);
+	if (play_wait(data) == ERROR)
+		return;
+	play_stop(data);
+	data->audio->exit(data);
+}
+
+/* Playback counters of a zone, including the playing track */
+void
+play_stats(struct info *data, struct zonestats *st)
+{
+	*st = data->zone_st;
+	if (data->stream != NULL) {
+		st->bytes += stream_bytes(data->stream);
+		st->stalls += stream_stalls(data->stream);
+	}
 }
 
+/* Start the audio backend on a background thread.  Audio isn't needed
+ * until a mix is selected, so the UI does not wait for the VLC module
+ * scan.  The thread of the first zone sets up every zone, the other
+ * zones wait for it.
+ */
 int
 play_init(struct info *data)
 {
-	data->vlc_inst = libvlc_new(0, NULL);
-	if (data->vlc_inst == NULL)
-		goto error;
-	data->vlc_mp = libvlc_media_player_new(data->vlc_inst);
-	if (data->vlc_mp == NULL)
-		goto error;
+	struct info *z;
+	int errn;
+
+	for (z = data; z != NULL; z = z->zone_next) {
+		z->audio_status = ERROR;
+		z->audio_pending = FALSE;
+	}
 
 	/* Prevent VLC from printing errors to the console by directing stderr
 	 * to /dev/null.  These error messages mess up the ncurses window.
 	 */
 	(void)freopen("/dev/null", "wb", stderr);
 
+	errn = pthread_create(&data->audio_thread, NULL, play_initaudio,
+	    (void *)data);
+	if (errn != 0)
+		return ERROR;
+	data->audio_pending = TRUE;
+
 	return SUCCESS;
+}
 
-error:
-	if (data->vlc_inst)
-		libvlc_release(data->vlc_inst);
+/* Wait for play_init() to finish */
+int
+play_wait(struct info *data)
+{
+	struct info *owner;
 
-	return ERROR;
+	owner = data->vlc_shared != NULL ? data->vlc_shared : data;
+	if (owner->audio_pending == TRUE) {
+		(void)pthread_join(owner->audio_thread, NULL);
+		owner->audio_pending = FALSE;
+	}
+
+	return data->audio_status;
+}
+
+static void *
+play_initaudio(void *arg)
+{
+	struct info *data;
+
+	data = (struct info *)arg;
+	(void)data->audio->init(data);
+	data->phase[PHASE_VLC] = monotime() - data->start;
+
+	return NULL;
 }
 
 void
 play_next(struct info *data)
 {
 	char errormsg[] = "Next mix not found.";
+	char vlcmsg[] = "Audio output not available.";
 	int errn;
 	struct track *t;
-	libvlc_media_t *media;
+
+	data->dirty = TRUE;
 
 	/* Check if we are already on the last track.
 	 * If so request a similar mix and continue playing.
@@ -48,7 +100,7 @@ play_next(struct info *data)
 		if (data->m->track[data->m->track_count-1]->last == TRUE) {
 			errn = search_nextmix(data);
 			if (errn == ERROR) {
-				draw_error(errormsg);
+				notify_push(data, errormsg);
 				data->state = START;
 				return;
 			}
@@ -56,15 +108,30 @@ play_next(struct info *data)
 	}
 
 	t = mix_nexttrack(data);
+
+	/* Offline the stored tracks of a mix can run out before its last
+	 * track, continue with the next mix.
+	 */
+	if (t == NULL && fetch_online() == FALSE &&
+	    data->m->track_count > 0) {
+		errn = search_nextmix(data);
+		if (errn == SUCCESS) {
+			data->scroll = 0;
+			t = mix_nexttrack(data);
+		}
+	}
 	if (t == NULL)
 		return;
 
-	media = libvlc_media_new_location(data->vlc_inst, t->url);
-	if (media == NULL)
+	if (play_wait(data) == ERROR) {
+		notify_push(data, vlcmsg);
+		data->state = START;
+		return;
+	}
+	play_stop(data);
+	if (data->audio->play(data, t) == ERROR)
 		return;
-	libvlc_media_player_set_media(data->vlc_mp, media);
-	(void)libvlc_media_player_play(data->vlc_mp);
-	libvlc_media_release(media);
+	data->zone_st.tracks++;
 }
 
 void
@@ -75,7 +142,7 @@ play_nextmix(struct info *data)
 
 	errn = search_nextmix(data);
 	if (errn == ERROR) {
-		draw_error(errormsg);
+		notify_push(data, errormsg);
 		data->state = START;
 		return;
 	}
@@ -95,13 +162,46 @@ play_skip(struct info *data)
 	if (t->skip_allowed == TRUE && t->last == FALSE) {
 		play_next(data);
 	} else
-		draw_error(errormsg);
+		notify_push(data, errormsg);
+}
+
+/* Time and length of the playing track in milliseconds */
+void
+play_position(struct info *data, long long *time, long long *length,
+    int *paused)
+{
+	*time = 0;
+	*length = 0;
+	*paused = FALSE;
+	if (play_ready(data) == FALSE)
+		return;
+	data->audio->position(data, time, length, paused);
+}
+
+/* Whether the playing track is heard, its clock has started */
+int
+play_audible(struct info *data)
+{
+	long long time, length;
+	int paused;
+
+	play_position(data, &time, &length, &paused);
+	if (time > 0 && paused == FALSE)
+		return TRUE;
+	else
+		return FALSE;
 }
 
 int
 play_isoverthirtymark(struct info *data)
 {
-	if (libvlc_media_player_get_time(data->vlc_mp) >= (30 * 1000))
+	long long time, length;
+	int paused;
+
+	if (play_ready(data) == FALSE)
+		return FALSE;
+	data->audio->position(data, &time, &length, &paused);
+	if (time >= (30 * 1000))
 		return TRUE;
 	else
 		return FALSE;
@@ -110,10 +210,10 @@ play_isoverthirtymark(struct info *data)
 int
 play_ended(struct info *data)
 {
-	/* VLC states: IDLE/CLOSE=0, OPENING=1, BUFFERING=2, PLAYING=3, 
-	 * PAUSE=4, STOPPING=5, ENDED=6, ERROR=7
-	 */
-	if (libvlc_media_player_get_state(data->vlc_mp) >= 6)
+	/* A track that failed to play has ended as well */
+	if (play_ready(data) == FALSE)
+		return FALSE;
+	if (data->audio->state(data) == AUDIO_ENDED)
 		return TRUE;
 	else
 		return FALSE;
@@ -122,5 +222,38 @@ play_ended(struct info *data)
 void
 play_togglepause(struct info *data)
 {
-	libvlc_media_player_pause(data->vlc_mp);
+	if (play_ready(data) == FALSE)
+		return;
+	data->audio->pause(data);
+}
+
+/* Check without blocking whether the backend is initialized */
+static int
+play_ready(struct info *data)
+{
+	struct info *owner;
+
+	owner = data->vlc_shared != NULL ? data->vlc_shared : data;
+	if (owner->audio_pending == TRUE || data->audio_status == ERROR)
+		return FALSE;
+	else
+		return TRUE;
+}
+
+/* Stop playback and release the stream feeding it.  The stream is
+ * stopped first, so a VLC read waiting for data returns and VLC can
+ * close the media.
+ */
+static void
+play_stop(struct info *data)
+{
+	if (data->stream != NULL)
+		stream_stop(data->stream);
+	data->audio->stop(data);
+	if (data->stream == NULL)
+		return;
+	data->zone_st.bytes += stream_bytes(data->stream);
+	data->zone_st.stalls += stream_stalls(data->stream);
+	stream_free(data->stream);
+	data->stream = NULL;
 }
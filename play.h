@@ -3,13 +3,18 @@
 #ifndef PLAY_H
 #define PLAY_H
 
+#include <pthread.h>
 #include <stdio.h>
-#include <vlc/vlc.h>
 #include <wchar.h>
+#include "audio.h"
 #include "defs.h"
 #include "mix.h"
+#include "notify.h"
 #include "search.h"
+#include "stream.h"
+#include "util.h"
 
+int	play_audible(struct info *);
 int	play_init(struct info *);
 void	play_exit(struct info *);
 int	play_ended(struct info *);
@@ -17,7 +22,10 @@ int	play_isoverthirtymark(struct info *);
 void	play_togglepause(struct info *);
 void	play_next(struct info *);
 void	play_nextmix(struct info *);
+void	play_position(struct info *, long long *, long long *, int *);
 void	play_skip(struct info *);
+void	play_stats(struct info *, struct zonestats *);
+int	play_wait(struct info *);
 
 
 #endif
@@ -0,0 +1,347 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "prefetch.h"
+
+static int	 prefetch_isdone(struct prefetch *);
+static void	 prefetch_join(struct prefetch *);
+static int	 prefetch_start(struct prefetch *, struct info *, int,
+		    void *(*)(void *));
+static void	 prefetch_clear(struct prefetch *);
+static void	 prefetch_initjob(struct prefetch *, struct info *);
+static void	*prefetch_firsttrack(void *);
+static void	*prefetch_nextmix(void *);
+static void	*prefetch_playtoken(void *);
+
+void
+prefetch_init(struct info *data)
+{
+	prefetch_initjob(&data->pf_track, data);
+	prefetch_initjob(&data->pf_mix, data);
+	data->token_pending = FALSE;
+}
+
+void
+prefetch_exit(struct info *data)
+{
+	if (data->token_pending == TRUE) {
+		(void)pthread_join(data->token_thread, NULL);
+		data->token_pending = FALSE;
+	}
+
+	prefetch_clear(&data->pf_track);
+	(void)pthread_mutex_destroy(&data->pf_track.lock);
+	prefetch_clear(&data->pf_mix);
+	free(data->pf_mix.smart_id);
+	(void)pthread_mutex_destroy(&data->pf_mix.lock);
+}
+
+/* Request a play token in the background, so it is available by the
+ * time a mix is selected.
+ */
+void
+prefetch_token(struct info *data)
+{
+	int errn;
+
+	if (data->token_pending == TRUE)
+		return;
+	(void)pthread_mutex_lock(&data->token_lock);
+	if (data->playtoken != NULL || data->token_busy == TRUE) {
+		(void)pthread_mutex_unlock(&data->token_lock);
+		return;
+	}
+	(void)pthread_mutex_unlock(&data->token_lock);
+
+	errn = pthread_create(&data->token_thread, NULL, prefetch_playtoken,
+	    (void *)data);
+	if (errn == 0)
+		data->token_pending = TRUE;
+}
+
+/* Once the selection cursor has rested on a mix for PREFETCHDWELL
+ * milliseconds, fetch the first track of that mix.  A result for a mix
+ * that is no longer under the cursor is discarded.
+ */
+void
+prefetch_select(struct info *data)
+{
+	struct prefetch *pf;
+	struct mix *m;
+
+	if (data->mlist == NULL || data->view_size == 0)
+		return;
+	m = data->mlist[data->view[data->select_pos]];
+	if (m == NULL)
+		return;
+	if (monotime() - data->select_time < PREFETCHDWELL * 1000000ULL)
+		return;
+
+	pf = &data->pf_track;
+	if ((pf->running == TRUE || pf->t != NULL) && pf->mix_id == m->id)
+		return;
+
+	/* Let a stale request finish before starting a new one */
+	if (pf->running == TRUE && prefetch_isdone(pf) == FALSE)
+		return;
+	prefetch_clear(pf);
+
+	(void)prefetch_start(pf, data, m->id, prefetch_firsttrack);
+}
+
+/* Prepare the mix that follows the playing one.  The next mix itself is
+ * requested as soon as a mix plays, its first track once the final track
+ * of the playing mix has started.  The next mix does not depend on the
+ * track, so a single request per mix is made.
+ */
+void
+prefetch_play(struct info *data)
+{
+	struct prefetch *pf;
+	struct mix *m;
+	int last;
+
+	m = data->m;
+	if (m == NULL || m->track_count == 0 || data->search_str == NULL)
+		return;
+	last = m->track[m->track_count-1]->last;
+
+	pf = &data->pf_mix;
+	if (pf->running == TRUE && prefetch_isdone(pf) == FALSE)
+		return;
+	prefetch_join(pf);
+
+	if (pf->mix_id == m->id) {
+		/* A failed request is not retried, search_nextmix() will
+		 * make its own request at the mix boundary.
+		 */
+		if (last == FALSE || pf->m == NULL || pf->t != NULL ||
+		    pf->withtrack == TRUE)
+			return;
+	} else {
+		prefetch_clear(pf);
+		free(pf->smart_id);
+		pf->smart_id = malloc((strlen(data->search_str) + 1) *
+		    sizeof(char));
+		if (pf->smart_id == NULL)
+			err(1, NULL);
+		(void)strlcpy(pf->smart_id, data->search_str,
+		    strlen(data->search_str) + 1);
+	}
+
+	pf->withtrack = last;
+	(void)prefetch_start(pf, data, m->id, prefetch_nextmix);
+}
+
+/* Take the prefetched first track of a mix.  A request that is still in
+ * flight for the mix is waited for, it was started earlier than a new
+ * request would be.
+ */
+struct track *
+prefetch_take(struct info *data, int mix_id)
+{
+	struct prefetch *pf;
+	struct track *t;
+
+	pf = &data->pf_track;
+	if (pf->mix_id != mix_id)
+		return NULL;
+	prefetch_join(pf);
+	t = pf->t;
+	pf->t = NULL;
+	pf->mix_id = 0;
+
+	return t;
+}
+
+/* Take the prefetched mix following mix_id.  Its first track, if it was
+ * fetched, is handed to prefetch_take().
+ */
+struct mix *
+prefetch_takemix(struct info *data, int mix_id)
+{
+	struct prefetch *pf;
+	struct mix *m;
+
+	pf = &data->pf_mix;
+	if (pf->mix_id != mix_id)
+		return NULL;
+	prefetch_join(pf);
+	m = pf->m;
+	pf->m = NULL;
+	if (m != NULL && pf->t != NULL) {
+		prefetch_clear(&data->pf_track);
+		data->pf_track.mix_id = m->id;
+		data->pf_track.t = pf->t;
+		pf->t = NULL;
+	}
+	prefetch_clear(pf);
+
+	return m;
+}
+
+/* Milliseconds until prefetch_select() needs to run again */
+int
+prefetch_timeout(struct info *data)
+{
+	struct prefetch *pf;
+	struct mix *m;
+	uint64_t elapsed;
+
+	if (data->state != SELECT || data->mlist == NULL ||
+	    data->view_size == 0)
+		return HALFDELAY * 100;
+	m = data->mlist[data->view[data->select_pos]];
+	pf = &data->pf_track;
+	if (m == NULL || ((pf->running == TRUE || pf->t != NULL) &&
+	    pf->mix_id == m->id))
+		return HALFDELAY * 100;
+
+	/* Poll for a stale request to finish */
+	if (pf->running == TRUE && prefetch_isdone(pf) == FALSE)
+		return PREFETCHDWELL / 4;
+
+	elapsed = (monotime() - data->select_time) / 1000000;
+	if (elapsed >= PREFETCHDWELL)
+		return 0;
+
+	return PREFETCHDWELL - (int)elapsed;
+}
+
+/* Wait for a job and discard its results */
+static void
+prefetch_clear(struct prefetch *pf)
+{
+	prefetch_join(pf);
+	mix_free(pf->m);
+	pf->m = NULL;
+	track_free(pf->t);
+	pf->t = NULL;
+	pf->mix_id = 0;
+	pf->withtrack = FALSE;
+}
+
+static void
+prefetch_initjob(struct prefetch *pf, struct info *data)
+{
+	(void)pthread_mutex_init(&pf->lock, NULL);
+	pf->running = FALSE;
+	pf->done = FALSE;
+	pf->mix_id = 0;
+	pf->withtrack = FALSE;
+	pf->smart_id = NULL;
+	pf->m = NULL;
+	pf->t = NULL;
+	pf->data = data;
+}
+
+static int
+prefetch_isdone(struct prefetch *pf)
+{
+	int done;
+
+	(void)pthread_mutex_lock(&pf->lock);
+	done = pf->done;
+	(void)pthread_mutex_unlock(&pf->lock);
+
+	return done;
+}
+
+static void
+prefetch_join(struct prefetch *pf)
+{
+	if (pf->running == FALSE)
+		return;
+	(void)pthread_join(pf->thread, NULL);
+	pf->running = FALSE;
+}
+
+static int
+prefetch_start(struct prefetch *pf, struct info *data, int mix_id,
+    void *(*fn)(void *))
+{
+	int errn;
+
+	pf->data = data;
+	pf->mix_id = mix_id;
+	pf->done = FALSE;
+	errn = pthread_create(&pf->thread, NULL, fn, (void *)pf);
+	if (errn != 0) {
+		pf->mix_id = 0;
+		return ERROR;
+	}
+	pf->running = TRUE;
+
+	return SUCCESS;
+}
+
+static void *
+prefetch_firsttrack(void *arg)
+{
+	struct prefetch *pf;
+	struct track *t;
+
+	pf = (struct prefetch *)arg;
+	t = NULL;
+	(void)fetch_class(FC_PREFETCH);
+
+	if (setplaytoken(pf->data) == ERROR)
+		goto done;
+	t = mix_fetchtrack(pf->data->playtoken, pf->mix_id, 0);
+	if (t == NULL)
+		goto done;
+
+	/* Warm up the stream: resolve its redirects now, so VLC can open
+	 * the media location directly.
+	 */
+	(void)fetch_resolve(&t->url);
+
+done:
+	(void)pthread_mutex_lock(&pf->lock);
+	pf->t = t;
+	pf->done = TRUE;
+	(void)pthread_mutex_unlock(&pf->lock);
+
+	return NULL;
+}
+
+static void *
+prefetch_nextmix(void *arg)
+{
+	struct prefetch *pf;
+	struct mix *m;
+	struct track *t;
+
+	pf = (struct prefetch *)arg;
+	m = pf->m;
+	t = NULL;
+	(void)fetch_class(FC_PREFETCH);
+
+	if (setplaytoken(pf->data) == ERROR)
+		goto done;
+	if (m == NULL)
+		m = search_fetchnextmix(pf->data->playtoken, pf->mix_id,
+		    pf->smart_id);
+	if (m == NULL || pf->withtrack == FALSE)
+		goto done;
+	t = mix_fetchtrack(pf->data->playtoken, m->id, 0);
+	if (t != NULL)
+		(void)fetch_resolve(&t->url);
+
+done:
+	(void)pthread_mutex_lock(&pf->lock);
+	pf->m = m;
+	pf->t = t;
+	pf->done = TRUE;
+	(void)pthread_mutex_unlock(&pf->lock);
+
+	return NULL;
+}
+
+static void *
+prefetch_playtoken(void *arg)
+{
+	(void)fetch_class(FC_PREFETCH);
+	(void)setplaytoken((struct info *)arg);
+
+	return NULL;
+}
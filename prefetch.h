@@ -0,0 +1,24 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "defs.h"
+#include "fetch.h"
+#include "mix.h"
+#include "search.h"
+#include "track.h"
+#include "util.h"
+
+void		 prefetch_exit(struct info *);
+void		 prefetch_init(struct info *);
+void		 prefetch_play(struct info *);
+void		 prefetch_select(struct info *);
+struct track	*prefetch_take(struct info *, int);
+struct mix	*prefetch_takemix(struct info *, int);
+int		 prefetch_timeout(struct info *);
+void		 prefetch_token(struct info *);
+
+#endif
@@ -0,0 +1,390 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "replay.h"
+
+static int	 replay_cmp(const void *, const void *);
+static int	 replay_read(struct replay *);
+static void	 replay_snap(struct replay *, const char *, int);
+
+/* A replay drives the UI from a script instead of the keyboard, on a
+ * virtual screen, and measures every frame.  Each line of the script is
+ * one of
+ *
+ *	type text	keys for the characters of text, one per frame
+ *	key name	one key: a character, enter, esc, tab, space,
+ *			backspace, delete, up, down, left, right, pageup
+ *			or pagedown
+ *	wait n		n iterations of the main loop without a key
+ *	until phase [n]	no keys until a phase of the benchmark ended n
+ *			times in all (default 1)
+ *	snap file	write the screen to file
+ *	expect file	compare the screen with file
+ *
+ * Empty lines and lines starting with # are skipped.  The replay ends
+ * with the script.
+ */
+struct frame {
+	uint64_t	 time;		/* Render time in ns */
+	int		 cells;		/* Cells that changed */
+	int64_t		 heap;		/* Bytes allocated while drawing */
+};
+struct replay {
+	FILE		*fp;
+	FILE		*log;		/* stderr before play_init() */
+	const char	*path;
+	int		 line;
+	char		 typed[CTLLINE];	/* Left of a type command */
+	size_t		 typed_pos;
+	int		 wait;
+	int		 until;		/* Phase waited for, or -1 */
+	int		 until_count;
+	struct frame	*frames;
+	size_t		 nframes;
+	size_t		 frames_cap;
+	wchar_t		*grid;		/* The screen, for changed cells */
+	int		 lines;
+	int		 cols;
+	int		 failures;
+};
+
+static const struct {
+	const char	*name;
+	wint_t		 c;
+	int		 fn;		/* A KEY_* code */
+} keys[] = {
+	{ "backspace",	KEY_BACKSPACE,	TRUE },
+	{ "delete",	KEY_DC,		TRUE },
+	{ "down",	KEY_DOWN,	TRUE },
+	{ "enter",	L'\n',		FALSE },
+	{ "esc",	0x1b,		FALSE },
+	{ "left",	KEY_LEFT,	TRUE },
+	{ "pagedown",	KEY_NPAGE,	TRUE },
+	{ "pageup",	KEY_PPAGE,	TRUE },
+	{ "right",	KEY_RIGHT,	TRUE },
+	{ "space",	L' ',		FALSE },
+	{ "tab",	L'\t',		FALSE },
+	{ "up",		KEY_UP,		TRUE }
+};
+
+/* Print the measurements of each frame and a summary.  Returns ERROR if
+ * a screen was not as expected.
+ */
+int
+replay_exit(struct info *data)
+{
+	struct replay *r;
+	uint64_t *times;
+	uint64_t cells;
+	int64_t heap;
+	size_t i, n;
+	int errn;
+
+	r = data->replay;
+	(void)printf("frame\trender_us\tcells\theap\n");
+	for (i = 0, cells = 0, heap = 0; i < r->nframes; i++) {
+		(void)printf("%zu\t%.1f\t%d\t%lld\n", i + 1,
+		    r->frames[i].time / 1e3, r->frames[i].cells,
+		    (long long)r->frames[i].heap);
+		cells += (uint64_t)r->frames[i].cells;
+		heap += r->frames[i].heap;
+	}
+
+	n = r->nframes;
+	if (n > 0) {
+		times = malloc(n * sizeof(uint64_t));
+		if (times == NULL)
+			err(1, NULL);
+		for (i = 0; i < n; i++)
+			times[i] = r->frames[i].time;
+		qsort(times, n, sizeof(uint64_t), replay_cmp);
+		(void)printf("# %zu frames, render p50 %.1f us p99 %.1f us "
+		    "max %.1f us, %llu cells changed, heap %+lld bytes\n", n,
+		    times[n / 2] / 1e3, times[n * 99 / 100] / 1e3,
+		    times[n - 1] / 1e3, (unsigned long long)cells,
+		    (long long)heap);
+		free(times);
+	}
+	bench_print(stdout);
+	if (r->failures > 0)
+		(void)fprintf(r->log, "%s: %d failures\n", r->path,
+		    r->failures);
+	errn = r->failures > 0 ? ERROR : SUCCESS;
+
+	(void)fclose(r->fp);
+	(void)fclose(r->log);
+	free(r->frames);
+	free(r->grid);
+	free(r);
+	data->replay = NULL;
+
+	return errn;
+}
+
+/* Called after every full redraw */
+void
+replay_frame(struct info *data, uint64_t time, int64_t heap)
+{
+	struct replay *r;
+
+	r = data->replay;
+	if (r->nframes == r->frames_cap) {
+		r->frames_cap = r->frames_cap > 0 ? r->frames_cap * 2 : 256;
+		r->frames = realloc(r->frames,
+		    r->frames_cap * sizeof(struct frame));
+		if (r->frames == NULL)
+			err(1, NULL);
+	}
+	r->frames[r->nframes].time = time;
+	r->frames[r->nframes].heap = heap;
+	r->frames[r->nframes].cells = replay_read(r);
+	r->nframes++;
+}
+
+int
+replay_init(struct info *data, const char *path)
+{
+	struct replay *r;
+	int fd;
+
+	r = malloc(sizeof(struct replay));
+	if (r == NULL)
+		err(1, NULL);
+	memset(r, 0, sizeof(struct replay));
+	r->fp = fopen(path, "r");
+	if (r->fp == NULL) {
+		free(r);
+		return ERROR;
+	}
+
+	/* play_init() sends stderr to /dev/null, keep a copy for the
+	 * failures of the script.
+	 */
+	fd = dup(STDERR_FILENO);
+	r->log = fd != -1 ? fdopen(fd, "w") : NULL;
+	if (r->log == NULL)
+		err(1, "stderr");
+	r->path = path;
+	r->until = -1;
+	data->replay = r;
+
+	return SUCCESS;
+}
+
+/* Queue the next key of the script, called before every key_handle() */
+void
+replay_step(struct info *data)
+{
+	struct replay *r;
+	char line[CTLLINE];
+	char *cmd, *arg, *ep;
+	mbstate_t ps;
+	wchar_t wc;
+	size_t i, n;
+	long l;
+
+	r = data->replay;
+	if (r->wait > 0) {
+		r->wait--;
+		return;
+	}
+	if (r->until != -1 && bench_count(r->until) < r->until_count)
+		return;
+	r->until = -1;
+
+	/* Type the rest of a text */
+	if (r->typed[r->typed_pos] != '\0') {
+		memset(&ps, 0, sizeof(ps));
+		n = mbrtowc(&wc, r->typed + r->typed_pos,
+		    strlen(r->typed + r->typed_pos), &ps);
+		if (n == (size_t)-1 || n == (size_t)-2) {
+			r->typed[r->typed_pos] = '\0';
+			r->failures++;
+			return;
+		}
+		r->typed_pos += n;
+		(void)unget_wch(wc);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), r->fp) != NULL) {
+		r->line++;
+		line[strcspn(line, "\n")] = '\0';
+		for (cmd = line; isspace((unsigned char)*cmd); cmd++)
+			;
+		if (*cmd == '\0' || *cmd == '#')
+			continue;
+		arg = cmd + strcspn(cmd, " \t");
+		if (*arg != '\0')
+			*arg++ = '\0';
+		arg += strspn(arg, " \t");
+
+		if (strcmp(cmd, "type") == 0) {
+			(void)strlcpy(r->typed, arg, sizeof(r->typed));
+			r->typed_pos = 0;
+			replay_step(data);
+			return;
+		} else if (strcmp(cmd, "key") == 0) {
+			for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+				if (strcmp(arg, keys[i].name) != 0)
+					continue;
+				if (keys[i].fn == TRUE)
+					(void)ungetch((int)keys[i].c);
+				else
+					(void)unget_wch((wchar_t)keys[i].c);
+				return;
+			}
+			if (mbtowc(&wc, arg, strlen(arg)) == (int)strlen(arg)) {
+				(void)unget_wch(wc);
+				return;
+			}
+		} else if (strcmp(cmd, "wait") == 0) {
+			l = strtol(arg, &ep, 10);
+			if (*arg != '\0' && *ep == '\0' && l > 0 &&
+			    l <= INT_MAX) {
+				r->wait = (int)l - 1;
+				return;
+			}
+		} else if (strcmp(cmd, "until") == 0) {
+			ep = arg + strcspn(arg, " \t");
+			l = 1;
+			if (*ep != '\0') {
+				*ep++ = '\0';
+				l = strtol(ep, &ep, 10);
+			}
+			r->until = bench_find(arg);
+			if (r->until != -1 && *ep == '\0' && l > 0 &&
+			    l <= INT_MAX) {
+				r->until_count = (int)l;
+				return;
+			}
+			r->until = -1;
+		} else if (strcmp(cmd, "snap") == 0 && *arg != '\0') {
+			replay_snap(r, arg, FALSE);
+			continue;
+		} else if (strcmp(cmd, "expect") == 0 && *arg != '\0') {
+			replay_snap(r, arg, TRUE);
+			continue;
+		}
+		(void)fprintf(r->log, "%s:%d: invalid line\n", r->path,
+		    r->line);
+		r->failures++;
+	}
+	data->quit = TRUE;
+}
+
+static int
+replay_cmp(const void *a, const void *b)
+{
+	uint64_t x, y;
+
+	x = *(const uint64_t *)a;
+	y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Read the screen into the grid, returns the number of cells that
+ * changed.  The second column of a wide character reads as L'\0'.
+ */
+static int
+replay_read(struct replay *r)
+{
+	cchar_t cc;
+	wchar_t wc[CCHARW_MAX + 1];
+	attr_t attr;
+	short pair;
+	int y, x, cy, cx, changed;
+
+	if (r->grid == NULL || r->lines != LINES || r->cols != COLS) {
+		free(r->grid);
+		r->lines = LINES;
+		r->cols = COLS;
+		r->grid = calloc((size_t)LINES * COLS, sizeof(wchar_t));
+		if (r->grid == NULL)
+			err(1, NULL);
+	}
+
+	getyx(stdscr, cy, cx);
+	changed = 0;
+	for (y = 0; y < LINES; y++) {
+		for (x = 0; x < COLS; x++) {
+			wc[0] = L' ';
+			if (mvwin_wch(stdscr, y, x, &cc) != ERR)
+				(void)getcchar(&cc, wc, &attr, &pair, NULL);
+			if (r->grid[y * COLS + x] != wc[0]) {
+				r->grid[y * COLS + x] = wc[0];
+				changed++;
+			}
+			if (wcwidth(wc[0]) == 2 && x + 1 < COLS) {
+				x++;
+				r->grid[y * COLS + x] = L'\0';
+			}
+		}
+	}
+	(void)wmove(stdscr, cy, cx);
+
+	return changed;
+}
+
+/* Write the screen to a file, or with expect compare it with the file */
+static void
+replay_snap(struct replay *r, const char *path, int expect)
+{
+	char mb[MB_LEN_MAX];
+	char *buf, *old;
+	size_t len, oldlen, n;
+	mbstate_t ps;
+	FILE *fp;
+	int y, x, end;
+
+	(void)replay_read(r);
+	fp = open_memstream(&buf, &len);
+	if (fp == NULL)
+		err(1, NULL);
+	memset(&ps, 0, sizeof(ps));
+	for (y = 0; y < r->lines; y++) {
+		for (end = r->cols; end > 0 &&
+		    r->grid[y * r->cols + end - 1] == L' '; end--)
+			;
+		for (x = 0; x < end; x++) {
+			if (r->grid[y * r->cols + x] == L'\0')
+				continue;
+			n = wcrtomb(mb, r->grid[y * r->cols + x], &ps);
+			if (n != (size_t)-1)
+				(void)fwrite(mb, 1, n, fp);
+		}
+		(void)fputc('\n', fp);
+	}
+	(void)fclose(fp);
+
+	if (expect == FALSE) {
+		fp = fopen(path, "w");
+		if (fp == NULL || fwrite(buf, 1, len, fp) != len) {
+			(void)fprintf(r->log, "%s:%d: cannot write %s\n",
+			    r->path, r->line, path);
+			r->failures++;
+		}
+		if (fp != NULL)
+			(void)fclose(fp);
+		free(buf);
+		return;
+	}
+
+	old = NULL;
+	oldlen = 0;
+	fp = fopen(path, "r");
+	if (fp != NULL) {
+		old = malloc(len + 1);
+		if (old == NULL)
+			err(1, NULL);
+		oldlen = fread(old, 1, len + 1, fp);
+		(void)fclose(fp);
+	}
+	if (old == NULL || oldlen != len || memcmp(old, buf, len) != 0) {
+		(void)fprintf(r->log, "%s:%d: screen differs from %s\n",
+		    r->path, r->line, path);
+		r->failures++;
+	}
+	free(old);
+	free(buf);
+}
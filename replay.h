@@ -0,0 +1,24 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <ctype.h>
+#include <err.h>
+#include <ncurses.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "bench.h"
+#include "defs.h"
+#include "util.h"
+
+int	replay_exit(struct info *);
+void	replay_frame(struct info *, uint64_t, int64_t);
+int	replay_init(struct info *, const char *);
+void	replay_step(struct info *);
+
+#endif
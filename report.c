@@ -2,13 +2,19 @@
 
 #include "report.h"
 
+static int	report_path(char *, size_t);
+static int	report_queue(const char *, int, int, int);
+static int	report_send(struct info *, int, int);
+
+/* Reports that fail, for example while offline, are queued in a file
+ * and sent later by report_flush().
+ */
 void
 report(struct info *data)
 {
 	struct track *t;
 	int index;
-	char *js, *url;
-	size_t len;
+	char path[PATH_MAX];
 
 	index = data->m->track_count - 1;
 	t = data->m->track[index];
@@ -16,26 +22,142 @@ report(struct info *data)
 	/* Report only once */
 	if (t->reported == TRUE)
 		return;
-
-	/* Set up url */
-	len = strlen("http://8tracks.com/sets/") + strlen(data->playtoken) +
-	    strlen("/report?track_id=") + intlen(t->id) +
-	    strlen("&mix_id=") + intlen(data->m->id) + 1;
-	url = malloc(len * sizeof(char));
-	if (url == NULL)
-		err(1, NULL);
-	(void)snprintf(url, len,
-	    "http://8tracks.com/sets/%s/report?track_id=%d&mix_id=%d",
-	    data->playtoken, t->id, data->m->id);
-
-	/* Report track */
-	js = malloc(1);
-	if (js == NULL)
-		err(1, NULL);
-	(void)fetch(&js, url); /* Just reporting, result doesn't matter. */
 	t->reported = TRUE;
 
-	/* Cleanup */
-	free(js);
-	free(url);
+	if (report_send(data, t->id, data->m->id) == SUCCESS)
+		return;
+	if (report_path(path, sizeof(path)) == ERROR ||
+	    report_queue(path, t->id, data->m->id, 0) == ERROR)
+		return;
+	data->reports_queued = TRUE;
+}
+
+/* Send the oldest queued report.  Only one report is sent per call,
+ * so the main loop is not held up when the queue is long.  The report
+ * is taken off the queue before it is sent, so a crash loses it rather
+ * than sending it twice.  A failed report goes to the end of the queue
+ * with its count of tries, and is dropped after REPORTTRIES of them.
+ * Sending waits REPORTRETRY seconds after a failure, doubled for every
+ * further failure in a row up to REPORTRETRYMAX.
+ */
+void
+report_flush(struct info *data)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	char line[64];
+	FILE *fp, *out;
+	uint64_t delay;
+	int fd, n, track_id, mix_id, tries, left;
+
+	if (data->reports_queued == FALSE || fetch_online() == FALSE ||
+	    monotime() < data->reports_retry)
+		return;
+	if (report_path(path, sizeof(path)) == ERROR)
+		return;
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		data->reports_queued = FALSE;
+		return;
+	}
+	tries = 0;
+	if (fgets(line, sizeof(line), fp) == NULL ||
+	    sscanf(line, "%d %d %d", &track_id, &mix_id, &tries) < 2) {
+		(void)fclose(fp);
+		(void)unlink(path);
+		data->reports_queued = FALSE;
+		return;
+	}
+
+	/* Rewrite the queue without the report about to be sent */
+	n = snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+	if (n < 0 || (size_t)n >= sizeof(tmp)) {
+		(void)fclose(fp);
+		return;
+	}
+	fd = mkstemp(tmp);
+	out = fd == -1 ? NULL : fdopen(fd, "w");
+	if (out == NULL) {
+		if (fd != -1) {
+			(void)close(fd);
+			(void)unlink(tmp);
+		}
+		(void)fclose(fp);
+		return;
+	}
+	for (left = 0; fgets(line, sizeof(line), fp) != NULL; left++)
+		(void)fputs(line, out);
+	(void)fclose(fp);
+	if (fclose(out) == EOF || rename(tmp, path) == -1) {
+		(void)unlink(tmp);
+		return;
+	}
+	if (left == 0) {
+		(void)unlink(path);
+		data->reports_queued = FALSE;
+	}
+
+	if (setplaytoken(data) == SUCCESS &&
+	    report_send(data, track_id, mix_id) == SUCCESS) {
+		data->reports_failed = 0;
+		data->reports_retry = 0;
+		return;
+	}
+
+	if (++tries < REPORTTRIES &&
+	    report_queue(path, track_id, mix_id, tries) == SUCCESS)
+		data->reports_queued = TRUE;
+	delay = REPORTRETRYMAX;
+	if (data->reports_failed < 16 &&
+	    (REPORTRETRY << data->reports_failed) < REPORTRETRYMAX)
+		delay = REPORTRETRY << data->reports_failed;
+	data->reports_failed++;
+	data->reports_retry = monotime() + delay * 1000000000ULL;
+}
+
+static int
+report_path(char *path, size_t len)
+{
+	if (datadir(path, len, "") == ERROR ||
+	    strlcat(path, "reports", len) >= len)
+		return ERROR;
+
+	return SUCCESS;
+}
+
+/* Append a report to the end of the queue */
+static int
+report_queue(const char *path, int track_id, int mix_id, int tries)
+{
+	FILE *fp;
+	int n;
+
+	fp = fopen(path, "a");
+	if (fp == NULL)
+		return ERROR;
+	n = fprintf(fp, "%d %d %d\n", track_id, mix_id, tries);
+	if (fclose(fp) == EOF || n < 0)
+		return ERROR;
+
+	return SUCCESS;
+}
+
+static int
+report_send(struct info *data, int track_id, int mix_id)
+{
+	struct apiargs args;
+	int cls, errn;
+
+	if (data->playtoken == NULL)
+		return ERROR;
+
+	/* Report track, the response doesn't matter */
+	memset(&args, 0, sizeof(args));
+	args.token = data->playtoken;
+	args.track_id = track_id;
+	args.mix_id = mix_id;
+	cls = fetch_class(FC_REPORT);
+	errn = api_send(API_REPORT, &args);
+	(void)fetch_class(cls);
+
+	return errn;
 }
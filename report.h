@@ -3,12 +3,19 @@
 #ifndef REPORT_H
 #define REPORT_H
 
+#include <bsd/string.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "api.h"
 #include "defs.h"
 #include "fetch.h"
 #include "string.h"
+#include "util.h"
 
 void	report(struct info *);
+void	report_flush(struct info *);
 
 #endif
@@ -2,9 +2,13 @@
 
 #include "search.h"
 
-static void	searchstr_pop(struct info *);
-static void	searchstr_push(struct info *, wint_t);
-static size_t	searchstr_length(struct info *);
+static int		 search_islocal(const char *);
+static struct mix	*search_storednextmix(int, const char *, int);
+static void		 search_suggest(struct info *);
+static size_t		 searchstr_get(struct info *, char *, size_t);
+static void		 searchstr_pop(struct info *);
+static void		 searchstr_push(struct info *, wint_t);
+static size_t		 searchstr_length(struct info *);
 
 void
 search_init(struct info *data)
@@ -13,6 +17,9 @@ search_init(struct info *data)
 	data->state = SEARCH;
 	searchstr_clear(data);
 	data->scroll = 0;
+
+	/* A play token will be needed if a mix is selected */
+	prefetch_token(data);
 }
 
 void
@@ -30,12 +37,37 @@ search_backspace(struct info *data)
 		data->cursor_pos--;
 		searchstr_pop(data);
 	}
+	search_suggest(data);
+}
+
+/* Append the rest of the first completion */
+void
+search_complete(struct info *data)
+{
+	const char *p;
+	mbstate_t ps;
+	wchar_t wc;
+	size_t n;
+
+	if (data->suggest_count == 0)
+		return;
+	data->cursor_pos = (int)searchstr_length(data);
+	memset(&ps, 0, sizeof(ps));
+	for (p = data->suggest[0] + data->suggest_skip; *p != '\0'; p += n) {
+		n = mbrtowc(&wc, p, strlen(p), &ps);
+		if (n == (size_t)-1 || n == (size_t)-2 || n == 0)
+			break;
+		searchstr_push(data, (wint_t)wc);
+		data->cursor_pos++;
+	}
+	search_suggest(data);
 }
 
 void
 search_delete(struct info *data)
 {
 	searchstr_pop(data);
+	search_suggest(data);
 }
 
 void
@@ -53,6 +85,7 @@ search_changepos(struct info *data, wint_t c)
 	default:
 		break;
 	}
+	search_suggest(data);
 }
 
 void
@@ -73,23 +106,24 @@ search_addchar(struct info *data, wint_t c)
 
 	searchstr_push(data, c);
 	data->cursor_pos++;
+	search_suggest(data);
 }
 
 void
 search_search(struct info *data)
 {
 	char errormsg[] = "Search returned no results.";
-	char *js, *tmp, *url;
+	char *tmp;
 	int tmp_len;
 	size_t len;
 	struct search_node *it;
-	int errn;
-	json_t *root, *status, *mix_set, *mixes;
+	json_t *root, *mixes;
 	int i;
 
 	/* Initialize variables */
 	root = NULL;
 	data->mlist = NULL;
+	bench_begin(BENCH_SEARCH);
 
 	/* Set data->search_str to the entered smart id.
 	 * If no search string is entered, default to smart id "all".
@@ -121,39 +155,14 @@ search_search(struct info *data)
 	}
 	searchstr_clear(data);
 
-	/* Build url */
-	len = strlen("http://8tracks.com/mix_sets/") +
-	    strlen(data->search_str) + strlen("?include=mixes[liked]") + 1;
-	url = malloc(len * sizeof(char));
-	if (url == NULL)
-		err(1, NULL);
-	(void)snprintf(url, len,
-	    "http://8tracks.com/mix_sets/%s?include=mixes[liked]",
-	    data->search_str);
-
 	/* Start the search */
 	data->state = SEARCHING;
 	draw_redraw(data);
 
-	/* Fetch the url */
-	js = malloc(1);
-	if (js == NULL)
-		err(1, NULL);
-	errn = fetch(&js, url);
-	if (errn == ERROR)
-		goto error;
-
-	/* Parse json*/
-	root = json_loads(js, 0, NULL);
+	root = search_fetchpage(data->search_str, 1);
 	if (root == NULL)
 		goto error;
-	status = json_object_get(root, "status");
-	if (strcmp(json_string_value(status), "200 OK") != 0)
-		goto error;
-	mix_set = json_object_get(root, "mix_set");
-	if (mix_set == NULL)
-		goto error;
-	mixes = json_object_get(mix_set, "mixes");
+	mixes = json_object_get(json_object_get(root, "mix_set"), "mixes");
 	if (!json_is_array(mixes))
 		goto error;
 	data->mlist_size = json_array_size(mixes);
@@ -164,93 +173,215 @@ search_search(struct info *data)
 		data->mlist[i] = mix_create(json_array_get(mixes, i));
 
 	select_init(data);
+	enrich_start(data);
 
 	/* Cleanup */
 	json_decref(root);
-	free(url);
-	free(js);
 
 	return;
 
 error:
-	if (url)
-		free(url);
-	if (js)
-		free(js);
 	if (root)
 		json_decref(root);
 
-	draw_error(errormsg);
+	notify_push(data, errormsg);
 	data->state = data->pstate;
 
 	return;
 }
 
-int
-search_nextmix(struct info *data)
+/* Fetch a page of the mixes for a smart id, the response is kept in the
+ * store.  Returns the parsed response, its mixes are in mix_set.mixes.
+ */
+json_t *
+search_fetchpage(const char *smart_id, int page)
 {
-	char *js, *url;
-	int errn;
-	size_t len;
-	json_t *root, *status, *mix_set;
+	struct apiargs args;
+	json_t *root, *mix_set;
+	const char *q;
+
+	/* The local index answers in a single page */
+	if (search_islocal(smart_id) == TRUE)
+		return page <= 1 ? local_query(smart_id + strlen("local:")) :
+		    NULL;
+
+	/* The first page is stored under the plain key */
+	memset(&args, 0, sizeof(args));
+	args.smart_id = smart_id;
+	args.page = page;
+	root = api_get(page <= 1 ? API_MIXSET : API_MIXSETPAGE, &args,
+	    &mix_set);
+
+	/* Offline a search never made before is looked up locally */
+	if (root == NULL && page <= 1 && fetch_online() == FALSE) {
+		q = strchr(smart_id, ':');
+		root = local_query(q != NULL ? q + 1 : "");
+	}
 
-	js = NULL;
-	url = NULL;
-	root = NULL;
+	return root;
+}
 
-	/* Build url */
-	len = strlen("http://8tracks.com/sets/") + strlen(data->playtoken) +
-	    strlen("/next_mix?mix_id=") + intlen(data->m->id) +
-	    strlen("&include=mixes[liked]&smart_id=") +
-	    strlen(data->search_str) + 1;
-	url = malloc(len * sizeof(char));
-	if (url == NULL)
-		err(1, NULL);
-	(void)snprintf(url, len,
-	    "http://8tracks.com/sets/%s/next_mix?mix_id=%d&include=mixes[liked]&smart_id=%s",
-	    data->playtoken, data->m->id, data->search_str);
+/* Fetch the mix that follows mix_id for a smart id.  Like
+ * mix_fetchtrack() this is safe to call from prefetch threads.
+ */
+struct mix *
+search_fetchnextmix(const char *playtoken, int mix_id, const char *smart_id)
+{
+	struct apiargs args;
+	json_t *root, *next_mix;
+	struct mix *m;
+
+	if (smart_id == NULL)
+		return NULL;
+
+	/* The server does not know local searches */
+	if (search_islocal(smart_id) == TRUE)
+		return search_storednextmix(mix_id, smart_id,
+		    fetch_online() == FALSE);
+
+	/* Without a play token only the store is used */
+	memset(&args, 0, sizeof(args));
+	args.token = playtoken;
+	args.mix_id = mix_id;
+	args.smart_id = smart_id;
+	root = api_get(API_NEXTMIX, &args, &next_mix);
+	if (root != NULL) {
+		m = mix_create(next_mix);
+		json_decref(root);
+		if (m != NULL)
+			return m;
+	}
 
-	/* Fetch url */
-	js = malloc(1);
-	if (js == NULL)
-		err(1, NULL);
-	errn = fetch(&js, url);
-	if (errn == ERROR)
-		goto error;
+	/* Offline any stored mix of the smart id will do */
+	if (fetch_online() == FALSE)
+		return search_storednextmix(mix_id, smart_id, TRUE);
 
-	/* Parse json */
-	root = json_loads(js, 0, NULL);
-	if (root == NULL)
-		goto error;
-	status = json_object_get(root, "status");
-	if (strcmp(json_string_value(status), "200 OK") != 0)
-		goto error;
-	mix_set = json_object_get(root, "next_mix");
-	if (mix_set == NULL)
-		goto error;
+	return NULL;
+}
+
+int
+search_nextmix(struct info *data)
+{
+	struct mix *m;
+
+	/* Use the next mix if it was fetched during the current one */
+	m = prefetch_takemix(data, data->m->id);
+	if (m == NULL)
+		m = search_fetchnextmix(data->playtoken, data->m->id,
+		    data->search_str);
+	if (m == NULL)
+		return ERROR;
 
-	/* Set mix */
 	mix_free(data->m);
-	data->m = mix_create(mix_set);
-	if (data->m == NULL)
-		goto error;
+	data->m = m;
 
-	/* Cleanup */
-	free(url);
-	free(js);
-	json_decref(root);
-	
 	return SUCCESS;
+}
 
-error:
-	if (js)
+static int
+search_islocal(const char *smart_id)
+{
+	return strncmp(smart_id, "local:", strlen("local:")) == 0;
+}
+
+/* Complete the smart id typed so far from the tags and performers seen
+ * before.  Only the term being typed is completed: the type of smart id,
+ * or the last of the tags joined by "+".
+ */
+static void
+search_suggest(struct info *data)
+{
+	char typed[COMPLETELEN], key[COMPLETELEN];
+	char found[COMPLETESHOW][COMPLETELEN];
+	const char *colon, *term;
+	size_t len, type;
+	int i, n;
+
+	data->suggest_count = 0;
+	if (data->cursor_pos != (int)searchstr_length(data))
+		return;
+	len = searchstr_get(data, typed, sizeof(typed));
+	if (len == 0 || len == (size_t)-1)
+		return;
+
+	colon = strchr(typed, ':');
+	if (colon == NULL)
+		term = typed;
+	else {
+		term = strrchr(colon, '+');
+		term = term != NULL ? term + 1 : colon + 1;
+		if (strchr(colon + 1, ':') != NULL)
+			return;		/* Past the smart id, e.g. ":recent" */
+	}
+	type = colon != NULL ? (size_t)(colon - typed) + 1 : 0;
+	if (type + strlen(term) >= sizeof(key))
+		return;
+	(void)memcpy(key, typed, type);
+	(void)strlcpy(key + type, term, sizeof(key) - type);
+
+	n = complete_lookup(key, found, COMPLETESHOW);
+	for (i = 0; i < n; i++) {
+		if (len + strlen(found[i]) - strlen(key) >= COMPLETELEN)
+			continue;
+		(void)snprintf(data->suggest[data->suggest_count++],
+		    COMPLETELEN, "%s%s", typed, found[i] + strlen(key));
+	}
+	data->suggest_skip = len;
+}
+
+/* Pick the stored or local search result that follows mix_id.  If
+ * stored is TRUE its first track has to be stored as well.
+ */
+static struct mix *
+search_storednextmix(int mix_id, const char *smart_id, int stored)
+{
+	struct apiargs args;
+	char *js;
+	char key[APIURL], setkey[64];
+	size_t i, j, n;
+	json_t *root, *mix_set, *mixes, *id;
+	struct mix *m;
+
+	memset(&args, 0, sizeof(args));
+	args.smart_id = smart_id;
+	if (search_islocal(smart_id) == TRUE)
+		root = local_query(smart_id + strlen("local:"));
+	else {
+		if (api_key(API_MIXSET, &args, key, sizeof(key)) == ERROR)
+			return NULL;
+		js = store_get(key);
+		if (js == NULL)
+			return NULL;
+		root = json_loads(js, 0, NULL);
 		free(js);
-	if (url)
-		free(url);
-	if (root)
-		json_decref(root);
+	}
+	if (root == NULL)
+		return NULL;
 
-	return ERROR;
+	m = NULL;
+	mix_set = json_object_get(root, "mix_set");
+	mixes = json_object_get(mix_set, "mixes");
+	n = json_array_size(mixes);
+
+	/* Start after the current mix and wrap around */
+	for (i = 0; i < n; i++) {
+		id = json_object_get(json_array_get(mixes, i), "id");
+		if (json_integer_value(id) == mix_id)
+			break;
+	}
+	for (j = 1; j <= n && m == NULL; j++) {
+		id = json_object_get(json_array_get(mixes, (i + j) % n), "id");
+		if (json_integer_value(id) == mix_id)
+			continue;
+		args.mix_id = (int)json_integer_value(id);
+		if (stored == FALSE ||
+		    (api_key(API_PLAY, &args, setkey, sizeof(setkey)) ==
+		    SUCCESS && store_has(setkey) == TRUE))
+			m = mix_create(json_array_get(mixes, (i + j) % n));
+	}
+	json_decref(root);
+
+	return m;
 }
 
 void
@@ -266,6 +397,31 @@ searchstr_clear(struct info *data)
 	}
 	data->cursor_pos = 0;
 	data->slist_head = NULL;
+	data->suggest_count = 0;
+}
+
+/* The search string as a multibyte string, or (size_t)-1 if it does not
+ * fit into len bytes.
+ */
+static size_t
+searchstr_get(struct info *data, char *buf, size_t len)
+{
+	char mb[MB_LEN_MAX];
+	struct search_node *it;
+	mbstate_t ps;
+	size_t n, pos;
+
+	memset(&ps, 0, sizeof(ps));
+	for (pos = 0, it = data->slist_head; it != NULL; it = it->next) {
+		n = wcrtomb(mb, (wchar_t)it->c, &ps);
+		if (n == (size_t)-1 || pos + n >= len)
+			return (size_t)-1;
+		(void)memcpy(buf + pos, mb, n);
+		pos += n;
+	}
+	buf[pos] = '\0';
+
+	return pos;
 }
 
 static size_t
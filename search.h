@@ -5,24 +5,36 @@
 
 #include <err.h>
 #include <jansson.h>
+#include <limits.h>
 #include <ncurses.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
+#include "api.h"
+#include "bench.h"
+#include "complete.h"
 #include "defs.h"
 #include "draw.h"
+#include "enrich.h"
 #include "fetch.h"
+#include "local.h"
+#include "notify.h"
+#include "prefetch.h"
 #include "select.h"
+#include "store.h"
 #include "string.h"
 
-void	search_init(struct info *);
-void	search_exit(struct info *);
-void	search_backspace(struct info *);
-void	searchstr_clear(struct info *);
-void	search_delete(struct info *);
-void	search_changepos(struct info *, wint_t);
-void	search_addchar(struct info *, wint_t);
-void	search_search(struct info *);
-int	search_nextmix(struct info *);
+void		 search_init(struct info *);
+void		 search_exit(struct info *);
+void		 search_backspace(struct info *);
+void		 searchstr_clear(struct info *);
+void		 search_delete(struct info *);
+void		 search_changepos(struct info *, wint_t);
+void		 search_complete(struct info *);
+void		 search_addchar(struct info *, wint_t);
+void		 search_search(struct info *);
+int		 search_nextmix(struct info *);
+struct mix	*search_fetchnextmix(const char *, int, const char *);
+json_t		*search_fetchpage(const char *, int);
 
 #endif
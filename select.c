@@ -2,12 +2,32 @@
 
 #include "select.h"
 
+static int	select_match(const char *, const char *);
+static int	select_order(const void *, const void *);
+static void	select_view(struct info *);
+
+/* A mix in the view, with what it is ordered by */
+struct viewent {
+	int		 idx;
+	int		 score;		/* Of the filter match */
+	int		 value;		/* Higher first */
+	const char	*name;		/* Ascending, instead of value */
+};
+
 void
 select_init(struct info *data)
 {
 	data->state = SELECT;
 	data->select_pos = 0;
+	data->select_time = monotime();
 	data->scroll = 0;
+	data->filtering = FALSE;
+	data->filter_len = 0;
+	data->filter[0] = L'\0';
+	free(data->view);		/* Of the previous search */
+	data->view = NULL;
+	data->view_size = 0;
+	select_view(data);
 }
 
 void
@@ -17,42 +37,237 @@ select_exit(struct info *data)
 
 	data->state = data->pstate;
 	data->scroll = 0;
+	data->filtering = FALSE;
 
 	for (i = 0; i < (int)data->mlist_size;  i++)
 		mix_free(data->mlist[i]);
 	free(data->mlist);
 	data->mlist = NULL;
+	free(data->view);
+	data->view = NULL;
+	data->view_size = 0;
 }
 
 void
 select_changepos(struct info *data, wint_t c)
 {
+	if (data->view_size == 0)
+		return;
 	if (c == KEY_UP) {
-		data->select_pos = mod(data->select_pos-1, data->mlist_size);
+		data->select_pos = mod(data->select_pos-1, data->view_size);
+		data->select_time = monotime();
 		data->scroll = 0;
 	} else if (c == KEY_DOWN) {
-		data->select_pos = mod(data->select_pos+1, data->mlist_size);
+		data->select_pos = mod(data->select_pos+1, data->view_size);
+		data->select_time = monotime();
 		data->scroll = 0;
 	}
 }
 
+/* The mix under the cursor or NULL */
+struct mix *
+select_current(struct info *data)
+{
+	if (data->mlist == NULL || data->view_size == 0)
+		return NULL;
+
+	return data->mlist[data->view[data->select_pos]];
+}
+
+/* Add a character to the filter, or remove the last one for '\b' */
+void
+select_filter(struct info *data, wint_t c)
+{
+	if (c == L'\b') {
+		if (data->filter_len == 0)
+			return;
+		data->filter_len--;
+	} else {
+		if (data->filter_len == FILTERLEN || iswcntrl(c))
+			return;
+		data->filter[data->filter_len++] = (wchar_t)c;
+	}
+	data->filter[data->filter_len] = L'\0';
+	select_view(data);
+}
+
+/* Start or stop typing a filter, stopping with clear drops it */
+void
+select_filtermode(struct info *data, int on, int clear)
+{
+	data->filtering = on;
+	if (clear == TRUE && data->filter_len > 0) {
+		data->filter_len = 0;
+		data->filter[0] = L'\0';
+		select_view(data);
+	}
+}
+
 void
 select_select(struct info *data)
 {
+	struct mix *m;
 	int i;
 
+	m = select_current(data);
+	if (m == NULL)
+		return;
+	bench_begin(BENCH_PLAY);
 	if (data->m)
 		mix_free(data->m);
-	data->m = data->mlist[data->select_pos];
+	data->m = m;
 	for (i = 0; i < (int)data->mlist_size; i++) {
-		if (i != data->select_pos)
+		if (data->mlist[i] != m)
 			mix_free(data->mlist[i]);
 	}
 	free(data->mlist);
 	data->mlist = NULL;
+	free(data->view);
+	data->view = NULL;
+	data->view_size = 0;
+	data->filtering = FALSE;
 
 	data->state = PLAY;
 	data->scroll = 0;
 	draw_redraw(data);
 	play_next(data);
 }
+
+/* Switch to the next order */
+void
+select_sort(struct info *data)
+{
+	data->sort = (data->sort + 1) % SORT_MAX;
+	select_view(data);
+}
+
+/* Score of a folded key for the folded filter: every word of the filter
+ * has to be in the key, at the start of a word of the key scores best,
+ * elsewhere next and as a subsequence of its characters least.  Returns
+ * 0 if a word is not found.  strstr() and memchr() do the scanning.
+ */
+static int
+select_match(const char *key, const char *filter)
+{
+	char word[FILTERLEN * MB_LEN_MAX + 1];
+	const char *end, *p, *w;
+	size_t len, i;
+	int score;
+
+	score = 0;
+	end = key + strlen(key);
+	for (w = filter; *w != '\0'; w += len) {
+		while (*w == ' ')
+			w++;
+		len = strcspn(w, " ");
+		if (len == 0)
+			break;
+		(void)memcpy(word, w, len);
+		word[len] = '\0';
+
+		p = strstr(key, word);
+		if (p != NULL) {
+			if (p == key || strchr(" \n,-", p[-1]) != NULL)
+				score += 3;
+			else
+				score += 2;
+			continue;
+		}
+		for (p = key, i = 0; i < len && p != NULL; i++) {
+			p = memchr(p, word[i], (size_t)(end - p));
+			if (p != NULL)
+				p++;
+		}
+		if (p == NULL)
+			return 0;
+		score += 1;
+	}
+
+	return score > 0 ? score : 1;
+}
+
+static int
+select_order(const void *a, const void *b)
+{
+	const struct viewent *x, *y;
+	int cmp;
+
+	x = (const struct viewent *)a;
+	y = (const struct viewent *)b;
+	if (x->score != y->score)
+		return y->score - x->score;
+	if (x->name != NULL && y->name != NULL) {
+		cmp = strcmp(x->name, y->name);
+		if (cmp != 0)
+			return cmp;
+	} else if (x->value != y->value)
+		return y->value > x->value ? 1 : -1;
+
+	return x->idx - y->idx;
+}
+
+/* Rebuild the view from mlist for the filter and order.  The cursor
+ * stays on its mix if that is still shown.
+ */
+static void
+select_view(struct info *data)
+{
+	wchar_t folded[FILTERLEN + 1];
+	char filter[FILTERLEN * MB_LEN_MAX + 1];
+	struct viewent *ent;
+	struct mix *m, *cur;
+	size_t i, n;
+	int j;
+
+	cur = select_current(data);
+	for (j = 0; j < data->filter_len; j++)
+		folded[j] = (wchar_t)towlower((wint_t)data->filter[j]);
+	folded[j] = L'\0';
+	if (wcstombs(filter, folded, sizeof(filter)) == (size_t)-1)
+		filter[0] = '\0';
+
+	ent = malloc((data->mlist_size + 1) * sizeof(struct viewent));
+	if (ent == NULL)
+		err(1, NULL);
+	for (i = 0, n = 0; i < data->mlist_size; i++) {
+		m = data->mlist[i];
+		ent[n].idx = (int)i;
+		ent[n].name = NULL;
+		ent[n].value = 0;
+		if (m == NULL) {
+			/* Only shown in the order of the server */
+			if (filter[0] != '\0' || data->sort != SORT_SERVER)
+				continue;
+			ent[n++].score = 0;
+			continue;
+		}
+		ent[n].score = filter[0] != '\0' ?
+		    select_match(m->key, filter) : 0;
+		if (filter[0] != '\0' && ent[n].score == 0)
+			continue;
+		switch (data->sort) {
+		case SORT_PLAYS:	ent[n].value = m->plays_count; break;
+		case SORT_LIKES:	ent[n].value = m->likes_count; break;
+		case SORT_TRACKS:	ent[n].value = m->tracks_count; break;
+		case SORT_NAME:		ent[n].name = m->key; break;
+		default:		break;
+		}
+		n++;
+	}
+	qsort(ent, n, sizeof(struct viewent), select_order);
+
+	free(data->view);
+	data->view = malloc((n + 1) * sizeof(int));
+	if (data->view == NULL)
+		err(1, NULL);
+	data->view_size = n;
+	data->select_pos = 0;
+	for (i = 0; i < n; i++) {
+		data->view[i] = ent[i].idx;
+		if (cur != NULL && data->mlist[ent[i].idx] == cur)
+			data->select_pos = (int)i;
+	}
+	free(ent);
+	data->select_time = monotime();
+	data->scroll = 0;
+}
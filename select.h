@@ -3,16 +3,25 @@
 #ifndef SELECT_H
 #define SELECT_H
 
+#include <limits.h>
 #include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wchar.h>
+#include <wctype.h>
+#include "bench.h"
 #include "defs.h"
 #include "mix.h"
 #include "play.h"
 #include "util.h"
 
-void	select_exit(struct info *);
-void	select_init(struct info *);
-void	select_changepos(struct info *, wint_t);
-void	select_select(struct info *);
+void		 select_exit(struct info *);
+void		 select_init(struct info *);
+void		 select_changepos(struct info *, wint_t);
+struct mix	*select_current(struct info *);
+void		 select_filter(struct info *, wint_t);
+void		 select_filtermode(struct info *, int, int);
+void		 select_select(struct info *);
+void		 select_sort(struct info *);
 
 #endif
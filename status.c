@@ -0,0 +1,151 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "status.h"
+
+static void	status_publish(const struct status *);
+
+/* The status is only written by the main thread.  The copy in shm is
+ * rewritten when the status changes, readers never need a syscall.
+ * One instance per user exports it: the one holding a lock on the
+ * object, which also removes it on exit.  A crashed instance leaves the
+ * object behind unlocked, the next one takes it over.
+ */
+static struct status	*status_shm = NULL;
+static struct status	 status_last;
+static char		 status_path[64];
+static int		 status_fd = -1;
+
+void
+status_exit(void)
+{
+	if (status_shm == NULL)
+		return;
+	(void)munmap(status_shm, sizeof(struct status));
+	(void)shm_unlink(status_path);
+	(void)close(status_fd);
+	status_fd = -1;
+	status_shm = NULL;
+}
+
+int
+status_init(void)
+{
+	struct stat sb, cur;
+	void *p;
+	int fd, n;
+
+	n = snprintf(status_path, sizeof(status_path), STATUSNAME,
+	    (unsigned)getuid());
+	if (n < 0 || (size_t)n >= sizeof(status_path))
+		return ERROR;
+	fd = shm_open(status_path, O_RDWR | O_CREAT, 0644);
+	if (fd == -1)
+		return ERROR;
+	if (flock(fd, LOCK_EX | LOCK_NB) == -1)
+		goto error;
+
+	/* The owner may have removed it between the open and the lock */
+	status_fd = shm_open(status_path, O_RDONLY, 0);
+	if (status_fd == -1)
+		goto error;
+	if (fstat(fd, &sb) == -1 || fstat(status_fd, &cur) == -1 ||
+	    sb.st_dev != cur.st_dev || sb.st_ino != cur.st_ino) {
+		(void)close(status_fd);
+		goto error;
+	}
+	(void)close(status_fd);
+	status_fd = fd;
+
+	if (ftruncate(fd, sizeof(struct status)) == -1)
+		goto error;
+	p = mmap(NULL, sizeof(struct status), PROT_READ | PROT_WRITE,
+	    MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		goto error;
+
+	/* A crash may have left a write half done */
+	status_shm = (struct status *)p;
+	__atomic_store_n(&status_shm->seq, 0, __ATOMIC_RELEASE);
+	memset(&status_last, 0, sizeof(status_last));
+	status_last.version = STATUSVERSION;
+	status_last.buffering = -1;
+	status_publish(&status_last);
+
+	return SUCCESS;
+
+error:
+	(void)close(fd);
+	status_fd = -1;
+
+	return ERROR;
+}
+
+void
+status_update(struct info *data)
+{
+	struct status st;
+	struct track *t;
+	struct notice *n;
+	struct timespec ts;
+	long long position, length;
+	int paused;
+
+	if (status_shm == NULL)
+		return;
+
+	memset(&st, 0, sizeof(st));
+	st.version = STATUSVERSION;
+	st.state = data->state;
+	st.online = fetch_online();
+	st.buffering = hud_vlcbuffering();
+	if (data->state == PLAY && data->m != NULL) {
+		st.mix_id = data->m->id;
+		if (data->m->name != NULL)
+			(void)strlcpy(st.mix_name, data->m->name,
+			    sizeof(st.mix_name));
+		t = NULL;
+		if (data->m->track_count > 0)
+			t = data->m->track[data->m->track_count - 1];
+		if (t != NULL) {
+			st.track_id = t->id;
+			(void)strlcpy(st.performer, t->performer,
+			    sizeof(st.performer));
+			(void)strlcpy(st.track_name, t->name,
+			    sizeof(st.track_name));
+		}
+		play_position(data, &position, &length, &paused);
+		st.position = position;
+		st.length = length;
+		st.paused = paused;
+	}
+
+	/* The last error stays until another one replaces it */
+	n = notify_current(data);
+	if (n != NULL)
+		(void)strlcpy(st.error, n->msg, sizeof(st.error));
+	else
+		(void)strlcpy(st.error, status_last.error, sizeof(st.error));
+
+	if (memcmp(&st, &status_last, sizeof(st)) == 0)
+		return;
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+	status_last = st;
+	st.updated = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	status_publish(&st);
+}
+
+static void
+status_publish(const struct status *st)
+{
+	uint32_t seq;
+
+	seq = status_shm->seq;
+	__atomic_store_n(&status_shm->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	status_shm->version = st->version;
+	status_shm->updated = st->updated;
+	memcpy((char *)status_shm + offsetof(struct status, state),
+	    (const char *)st + offsetof(struct status, state),
+	    sizeof(struct status) - offsetof(struct status, state));
+	__atomic_store_n(&status_shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
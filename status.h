@@ -0,0 +1,52 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bsd/string.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "defs.h"
+#include "fetch.h"
+#include "hud.h"
+#include "notify.h"
+#include "play.h"
+
+#define STATUSNAME	"/8p-status-%u"	/* Shared memory object per uid */
+#define STATUSVERSION	1
+
+/* The now playing status in shared memory.  seq is odd while the main
+ * thread writes; a reader copies the struct and retries until seq was
+ * even and unchanged around the copy.
+ */
+struct status {
+	uint32_t	version;
+	uint32_t	seq;
+	uint64_t	updated;	/* Unix time in milliseconds */
+	int32_t		state;		/* enum states */
+	int32_t		online;
+	int32_t		paused;
+	int32_t		buffering;	/* VLC buffering in percent, or -1 */
+	int64_t		position;	/* Milliseconds */
+	int64_t		length;
+	int32_t		mix_id;
+	int32_t		track_id;
+	char		mix_name[256];
+	char		performer[256];
+	char		track_name[256];
+	char		error[128];	/* Last notification */
+};
+
+void	status_exit(void);
+int	status_init(void);
+void	status_update(struct info *);
+
+#endif
@@ -0,0 +1,148 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "store.h"
+
+static int	storepath(char *, size_t, const char *);
+
+/* API responses are stored on disk by a key that does not depend on the
+ * play token, so they can be served when 8tracks.com is unreachable.
+ * Keys are percent-encoded into file names; a name that would not fit
+ * in NAME_MAX keeps a prefix of the key and ends in '~' and the FNV-1a
+ * hash of the whole key, a character the encoding never produces.
+ */
+static char	store_dir[PATH_MAX];
+static int	store_enabled = FALSE;
+
+int
+store_init(void)
+{
+	if (datadir(store_dir, sizeof(store_dir), "responses") == ERROR)
+		return ERROR;
+	store_enabled = TRUE;
+
+	return SUCCESS;
+}
+
+/* Returns the stored response for key or NULL */
+char *
+store_get(const char *key)
+{
+	char path[PATH_MAX];
+	char *js;
+	FILE *fp;
+	struct stat sb;
+
+	if (storepath(path, sizeof(path), key) == ERROR)
+		return NULL;
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return NULL;
+	if (fstat(fileno(fp), &sb) == -1) {
+		(void)fclose(fp);
+		return NULL;
+	}
+
+	js = malloc((size_t)sb.st_size + 1);
+	if (js == NULL)
+		err(1, NULL);
+	if (fread(js, 1, (size_t)sb.st_size, fp) != (size_t)sb.st_size) {
+		free(js);
+		(void)fclose(fp);
+		return NULL;
+	}
+	js[sb.st_size] = '\0';
+	(void)fclose(fp);
+
+	return js;
+}
+
+int
+store_has(const char *key)
+{
+	char path[PATH_MAX];
+
+	if (storepath(path, sizeof(path), key) == ERROR)
+		return FALSE;
+	if (access(path, R_OK) == -1)
+		return FALSE;
+
+	return TRUE;
+}
+
+/* Store a response, replacing the file atomically */
+int
+store_put(const char *key, const char *js)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	size_t len;
+	int fd, n;
+
+	if (js == NULL || storepath(path, sizeof(path), key) == ERROR)
+		return ERROR;
+	n = snprintf(tmp, sizeof(tmp), "%s/.tmp.XXXXXX", store_dir);
+	if (n < 0 || (size_t)n >= sizeof(tmp))
+		return ERROR;
+	fd = mkstemp(tmp);
+	if (fd == -1)
+		return ERROR;
+	len = strlen(js);
+	if (write(fd, js, len) != (ssize_t)len || close(fd) == -1) {
+		(void)unlink(tmp);
+		return ERROR;
+	}
+	if (rename(tmp, path) == -1) {
+		(void)unlink(tmp);
+		return ERROR;
+	}
+
+	return SUCCESS;
+}
+
+static int
+storepath(char *path, size_t len, const char *key)
+{
+	const char hex[] = "0123456789ABCDEF";
+	char name[NAME_MAX + 1];
+	const char *p;
+	unsigned long long h;
+	size_t i;
+	int n;
+
+	if (store_enabled == FALSE || key == NULL)
+		return ERROR;
+
+	for (i = 0, p = key; *p != '\0'; p++) {
+		if (i + 3 > NAME_MAX)
+			break;
+		if (isalnum((unsigned char)*p) || *p == '-' || *p == '.')
+			name[i++] = *p;
+		else {
+			name[i++] = '%';
+			name[i++] = hex[(unsigned char)*p >> 4];
+			name[i++] = hex[(unsigned char)*p & 0xf];
+		}
+	}
+	if (*p != '\0') {
+		/* Too long: cut between characters and append the hash */
+		h = 14695981039346656037ULL;
+		for (p = key; *p != '\0'; p++) {
+			h ^= (unsigned char)*p;
+			h *= 1099511628211ULL;
+		}
+		i = NAME_MAX - 17;
+		if (i >= 1 && name[i - 1] == '%')
+			i -= 1;
+		else if (i >= 2 && name[i - 2] == '%')
+			i -= 2;
+		n = snprintf(name + i, sizeof(name) - i, "~%016llx", h);
+		if (n < 0 || (size_t)n >= sizeof(name) - i)
+			return ERROR;
+	} else
+		name[i] = '\0';
+
+	n = snprintf(path, len, "%s/%s", store_dir, name);
+	if (n < 0 || (size_t)n >= len)
+		return ERROR;
+
+	return SUCCESS;
+}
@@ -0,0 +1,22 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <sys/stat.h>
+#include <ctype.h>
+#include <err.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "defs.h"
+#include "util.h"
+
+char	*store_get(const char *);
+int	 store_has(const char *);
+int	 store_init(void);
+int	 store_put(const char *, const char *);
+
+#endif
@@ -0,0 +1,483 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "stream.h"
+
+static void	*stream_download(void *);
+static int	 stream_progress(void *, curl_off_t, curl_off_t, curl_off_t,
+		    curl_off_t);
+static size_t	 stream_write(void *, size_t, size_t, void *);
+
+/* A stream downloads a track into a bounded ring buffer, from which
+ * VLC reads through the libvlc media callbacks.  The ring keeps the
+ * bytes between tail and head; the writer never overwrites bytes past
+ * the read position, bytes already read stay available for short
+ * backward seeks until they are overwritten.  A seek outside of the ring
+ * restarts the download at the new offset, so does a failed transfer
+ * up to STREAMRETRIES times in a row.
+ */
+struct stream *
+stream_create(const char *url, int id, size_t size, int mapped)
+{
+	struct stream *s;
+	FILE *fp;
+	size_t len;
+	int errn;
+
+	if (url == NULL || size == 0)
+		return NULL;
+
+	s = malloc(sizeof(struct stream));
+	if (s == NULL)
+		err(1, NULL);
+
+	len = strlen(url) + 1;
+	s->url = malloc(len * sizeof(char));
+	if (s->url == NULL)
+		err(1, NULL);
+	(void)strlcpy(s->url, url, len);
+
+	/* A file backed ring lets the kernel write cold pages to disk
+	 * instead of keeping them in memory.
+	 */
+	s->size = size;
+	s->mapped = FALSE;
+	s->buf = NULL;
+	if (mapped == TRUE) {
+		fp = tmpfile();
+		if (fp != NULL && ftruncate(fileno(fp), size) == 0) {
+			s->buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fileno(fp), 0);
+			if (s->buf == MAP_FAILED)
+				s->buf = NULL;
+			else
+				s->mapped = TRUE;
+		}
+		if (fp != NULL)
+			(void)fclose(fp);
+	}
+	if (s->buf == NULL) {
+		s->buf = malloc(size);
+		if (s->buf == NULL)
+			err(1, NULL);
+	}
+
+	s->curl = NULL;
+	s->offset = 0;
+	s->head = 0;
+	s->tail = 0;
+	s->pos = 0;
+	s->length = 0;
+	s->eof = FALSE;
+	s->error = FALSE;
+	s->stop = FALSE;
+	s->restart = FALSE;
+	s->received = 0;
+	s->dlnow = 0;
+	s->stalls = 0;
+	s->stall_time = 0;
+	s->bytes = 0;
+	s->id = id;
+	s->cached = 0;
+	s->cache_fp = cache_begin(id, s->cache_path, sizeof(s->cache_path));
+	(void)pthread_mutex_init(&s->lock, NULL);
+	(void)pthread_cond_init(&s->cond, NULL);
+
+	errn = pthread_create(&s->thread, NULL, stream_download, (void *)s);
+	if (errn != 0) {
+		s->running = FALSE;
+		s->error = TRUE;
+	} else
+		s->running = TRUE;
+
+	return s;
+}
+
+/* Make blocked and future reads return, so VLC can close the media */
+void
+stream_stop(struct stream *s)
+{
+	if (s == NULL)
+		return;
+
+	(void)pthread_mutex_lock(&s->lock);
+	s->stop = TRUE;
+	(void)pthread_cond_broadcast(&s->cond);
+	(void)pthread_mutex_unlock(&s->lock);
+}
+
+void
+stream_free(struct stream *s)
+{
+	if (s == NULL)
+		return;
+
+	stream_stop(s);
+	if (s->running == TRUE)
+		(void)pthread_join(s->thread, NULL);
+	cache_abort(s->cache_fp, s->cache_path);
+	if (s->mapped == TRUE)
+		(void)munmap(s->buf, s->size);
+	else
+		free(s->buf);
+	(void)pthread_mutex_destroy(&s->lock);
+	(void)pthread_cond_destroy(&s->cond);
+	free(s->url);
+	free(s);
+}
+
+/* Percentage of the ring filled with bytes that have not been read */
+int
+stream_fill(struct stream *s)
+{
+	int fill;
+
+	if (s == NULL)
+		return 0;
+
+	(void)pthread_mutex_lock(&s->lock);
+	fill = (int)((s->head - s->pos) * 100 / s->size);
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return fill;
+}
+
+/* Number of reads that found the ring empty */
+uint64_t
+stream_stalls(struct stream *s)
+{
+	uint64_t stalls;
+
+	if (s == NULL)
+		return 0;
+
+	(void)pthread_mutex_lock(&s->lock);
+	stalls = s->stalls;
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return stalls;
+}
+
+/* Bytes downloaded since the stream was created */
+uint64_t
+stream_bytes(struct stream *s)
+{
+	uint64_t bytes;
+
+	if (s == NULL)
+		return 0;
+
+	(void)pthread_mutex_lock(&s->lock);
+	bytes = s->bytes;
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return bytes;
+}
+
+int
+stream_open(void *opaque, void **datap, uint64_t *sizep)
+{
+	struct stream *s;
+
+	s = (struct stream *)opaque;
+	*datap = s;
+
+	/* Wait for the first bytes, which also give the length */
+	(void)pthread_mutex_lock(&s->lock);
+	while (s->head == 0 && s->eof == FALSE && s->error == FALSE &&
+	    s->stop == FALSE)
+		(void)pthread_cond_wait(&s->cond, &s->lock);
+	*sizep = s->length > 0 ? s->length : UINT64_MAX;
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+ssize_t
+stream_read(void *opaque, unsigned char *buf, size_t len)
+{
+	struct stream *s;
+	size_t n, off, chunk;
+	uint64_t start;
+
+	s = (struct stream *)opaque;
+
+	(void)pthread_mutex_lock(&s->lock);
+	if (s->pos == s->head && s->eof == FALSE && s->error == FALSE &&
+	    s->stop == FALSE) {
+		s->stalls++;
+		start = monotime();
+		while (s->pos == s->head && s->eof == FALSE &&
+		    s->error == FALSE && s->stop == FALSE)
+			(void)pthread_cond_wait(&s->cond, &s->lock);
+		s->stall_time += monotime() - start;
+	}
+	if (s->stop == TRUE || (s->pos == s->head && s->eof == TRUE)) {
+		(void)pthread_mutex_unlock(&s->lock);
+		return 0;
+	}
+	if (s->pos == s->head) {
+		(void)pthread_mutex_unlock(&s->lock);
+		return -1;
+	}
+
+	/* Copy the available bytes, wrapping around the end of the ring */
+	n = s->head - s->pos;
+	if (n > len)
+		n = len;
+	off = s->pos % s->size;
+	chunk = s->size - off;
+	if (chunk > n)
+		chunk = n;
+	memcpy(buf, &s->buf[off], chunk);
+	memcpy(&buf[chunk], s->buf, n - chunk);
+	s->pos += n;
+	(void)pthread_cond_broadcast(&s->cond);
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return (ssize_t)n;
+}
+
+int
+stream_seek(void *opaque, uint64_t offset)
+{
+	struct stream *s;
+
+	s = (struct stream *)opaque;
+
+	(void)pthread_mutex_lock(&s->lock);
+	if (offset < s->tail || offset > s->head) {
+		/* Outside of the ring, download from the new offset */
+		s->head = offset;
+		s->tail = offset;
+		s->eof = FALSE;
+		s->error = FALSE;
+		s->restart = TRUE;
+	}
+	s->pos = offset;
+	(void)pthread_cond_broadcast(&s->cond);
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+void
+stream_close(void *opaque)
+{
+	stream_stop((struct stream *)opaque);
+}
+
+static void *
+stream_download(void *arg)
+{
+	struct stream *s;
+	CURLcode curl_err;
+	struct timespec ts;
+	long status;
+	int tries;
+
+	s = (struct stream *)arg;
+	(void)fetch_class(FC_PLAYBACK);
+	tries = 0;
+
+	(void)pthread_mutex_lock(&s->lock);
+	for (;;) {
+		if (s->stop == TRUE)
+			break;
+		s->offset = s->head;
+		s->restart = FALSE;
+		s->received = monotime();
+		s->dlnow = 0;
+		(void)pthread_mutex_unlock(&s->lock);
+
+		trace_event(TR_STREAM, (uint32_t)s->id, s->offset);
+		curl_err = CURLE_FAILED_INIT;
+		status = 0;
+		s->curl = fetch_handle();
+		if (s->curl != NULL) {
+			(void)curl_easy_setopt(s->curl, CURLOPT_URL, s->url);
+			(void)curl_easy_setopt(s->curl,
+			    CURLOPT_RESUME_FROM_LARGE,
+			    (curl_off_t)s->offset);
+			(void)curl_easy_setopt(s->curl, CURLOPT_FAILONERROR,
+			    1L);
+			(void)curl_easy_setopt(s->curl, CURLOPT_WRITEFUNCTION,
+			    stream_write);
+			(void)curl_easy_setopt(s->curl, CURLOPT_WRITEDATA,
+			    (void *)s);
+			(void)curl_easy_setopt(s->curl,
+			    CURLOPT_XFERINFOFUNCTION, stream_progress);
+			(void)curl_easy_setopt(s->curl, CURLOPT_XFERINFODATA,
+			    (void *)s);
+			(void)curl_easy_setopt(s->curl, CURLOPT_NOPROGRESS,
+			    0L);
+			fetch_admit(FC_PLAYBACK);
+			curl_err = curl_easy_perform(s->curl);
+			fetch_release(FC_PLAYBACK);
+			(void)curl_easy_getinfo(s->curl, CURLINFO_RESPONSE_CODE,
+			    &status);
+			curl_easy_cleanup(s->curl);
+			s->curl = NULL;
+		}
+		trace_event(TR_STREAMED, (uint32_t)s->id, (uint64_t)curl_err);
+
+		(void)pthread_mutex_lock(&s->lock);
+		if (s->restart == TRUE) {
+			/* The cache copy would have a gap */
+			cache_abort(s->cache_fp, s->cache_path);
+			s->cache_fp = NULL;
+			tries = 0;
+			continue;
+		}
+		if (s->stop == TRUE)
+			break;
+		if (curl_err != CURLE_OK && s->length > 0 &&
+		    s->head >= s->length)
+			curl_err = CURLE_OK;
+
+		/* Resume from head after a failure, unless the server refused
+		 * the request.  A transfer that got bytes starts the count of
+		 * failures anew.  The cache copy goes on without a gap.
+		 */
+		if (s->head > s->offset)
+			tries = 0;
+		if (curl_err != CURLE_OK && (status < 400 || status > 499) &&
+		    ++tries <= STREAMRETRIES) {
+			s->stalls++;
+			(void)clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += (time_t)STREAMRETRY << (tries - 1);
+			while (s->stop == FALSE && s->restart == FALSE &&
+			    pthread_cond_timedwait(&s->cond, &s->lock, &ts) !=
+			    ETIMEDOUT)
+				;
+			if (s->restart == TRUE) {
+				cache_abort(s->cache_fp, s->cache_path);
+				s->cache_fp = NULL;
+				tries = 0;
+			}
+			continue;
+		}
+		tries = 0;
+		if (curl_err == CURLE_OK) {
+			s->eof = TRUE;
+			if (s->length == 0 || s->cached == s->length)
+				cache_commit(s->id, s->cache_fp,
+				    s->cache_path);
+			else
+				cache_abort(s->cache_fp, s->cache_path);
+		} else {
+			s->error = TRUE;
+			cache_abort(s->cache_fp, s->cache_path);
+		}
+		s->cache_fp = NULL;
+		(void)pthread_cond_broadcast(&s->cond);
+
+		/* Idle until a seek restarts the download */
+		while (s->stop == FALSE && s->restart == FALSE)
+			(void)pthread_cond_wait(&s->cond, &s->lock);
+	}
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return NULL;
+}
+
+/* Abort the transfer once the stream is stopped or restarted, or when
+ * no bytes arrived for STREAMSTALL seconds, which is then retried.
+ * Time spent waiting for the reader to make room does not count,
+ * stream_write() resets the clock.  This is called about once a second
+ * even while nothing arrives, so stream_free() does not wait on a
+ * stalled connection.
+ */
+static int
+stream_progress(void *arg, curl_off_t dltotal, curl_off_t dlnow,
+    curl_off_t ultotal, curl_off_t ulnow)
+{
+	struct stream *s;
+	uint64_t now;
+	int stop;
+
+	(void)dltotal;
+	(void)ultotal;
+	(void)ulnow;
+
+	s = (struct stream *)arg;
+	now = monotime();
+	(void)pthread_mutex_lock(&s->lock);
+	if (dlnow != s->dlnow) {
+		s->dlnow = dlnow;
+		s->received = now;
+	}
+	stop = s->stop == TRUE || s->restart == TRUE ||
+	    now - s->received > (uint64_t)STREAMSTALL * 1000000000;
+	(void)pthread_mutex_unlock(&s->lock);
+
+	return stop;
+}
+
+static size_t
+stream_write(void *contents, size_t size, size_t nmemb, void *arg)
+{
+	struct stream *s;
+	unsigned char *p;
+	size_t len, n, off, chunk;
+	uint64_t ahead;
+	curl_off_t cl;
+
+	s = (struct stream *)arg;
+	p = (unsigned char *)contents;
+	len = size * nmemb;
+
+	(void)pthread_mutex_lock(&s->lock);
+	if (s->length == 0 && curl_easy_getinfo(s->curl,
+	    CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &cl) == CURLE_OK && cl > 0)
+		s->length = s->offset + (uint64_t)cl;
+	while (len > 0) {
+		/* Returning short makes curl abort the transfer */
+		if (s->stop == TRUE || s->restart == TRUE)
+			break;
+
+		/* Wait for the reader to make room */
+		while (s->head - s->pos == s->size && s->stop == FALSE &&
+		    s->restart == FALSE)
+			(void)pthread_cond_wait(&s->cond, &s->lock);
+		if (s->stop == TRUE || s->restart == TRUE)
+			break;
+
+		n = s->size - (s->head - s->pos);
+		if (n > len)
+			n = len;
+		off = s->head % s->size;
+		chunk = s->size - off;
+		if (chunk > n)
+			chunk = n;
+		memcpy(&s->buf[off], p, chunk);
+		memcpy(s->buf, &p[chunk], n - chunk);
+		s->head += n;
+		if (s->head - s->tail > s->size)
+			s->tail = s->head - s->size;
+		s->bytes += n;
+		p += n;
+		len -= n;
+		(void)pthread_cond_broadcast(&s->cond);
+	}
+	len = size * nmemb - len;
+	ahead = s->head - s->pos;
+	s->received = monotime();
+	(void)pthread_mutex_unlock(&s->lock);
+
+	/* Only this thread uses the cache file, a slow disk does not hold
+	 * up the reader
+	 */
+	if (s->cache_fp != NULL && len > 0) {
+		if (fwrite(contents, 1, len, s->cache_fp) != len) {
+			cache_abort(s->cache_fp, s->cache_path);
+			s->cache_fp = NULL;
+		} else
+			s->cached += len;
+	}
+
+	/* Give way to interactive requests once well ahead of the reader */
+	if (ahead > s->size / 2)
+		fetch_shape(len);
+
+	return len;
+}
@@ -0,0 +1,74 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <bsd/string.h>
+#include <curl/curl.h>
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cache.h"
+#include "defs.h"
+#include "fetch.h"
+#include "util.h"
+
+struct stream {
+	pthread_t	 thread;
+	int		 running;
+	pthread_mutex_t	 lock;
+	pthread_cond_t	 cond;
+	CURL		*curl;		/* Transfer in progress */
+	char		*url;
+	unsigned char	*buf;
+	size_t		 size;
+	int		 mapped;	/* buf is a mapped file */
+	uint64_t	 offset;	/* Where the transfer started */
+	uint64_t	 head;		/* Stream offsets of the ring */
+	uint64_t	 tail;
+	uint64_t	 pos;		/* Read position */
+	uint64_t	 length;	/* 0 if unknown */
+	int		 eof;
+	int		 error;
+	int		 stop;
+	int		 restart;	/* Download again from head */
+	uint64_t	 received;	/* When bytes last arrived */
+	curl_off_t	 dlnow;		/* Bytes of the transfer so far */
+
+	/* The track is copied to the disk cache while it is downloaded
+	 * from its start without seeks.  Only the download thread uses
+	 * these, without the lock.
+	 */
+	int		 id;
+	FILE		*cache_fp;
+	char		 cache_path[PATH_MAX];
+	uint64_t	 cached;	/* Bytes written to cache_fp */
+
+	/* Statistics */
+	uint64_t	 stalls;
+	uint64_t	 stall_time;	/* Nanoseconds spent stalled */
+	uint64_t	 bytes;		/* Bytes downloaded */
+};
+
+uint64_t	 stream_bytes(struct stream *);
+struct stream	*stream_create(const char *, int, size_t, int);
+int		 stream_fill(struct stream *);
+void		 stream_free(struct stream *);
+uint64_t	 stream_stalls(struct stream *);
+void		 stream_stop(struct stream *);
+
+/* libvlc media callbacks, the opaque pointer is the stream */
+void		 stream_close(void *);
+int		 stream_open(void *, void **, uint64_t *);
+ssize_t		 stream_read(void *, unsigned char *, size_t);
+int		 stream_seek(void *, uint64_t);
+
+#endif
@@ -2,6 +2,45 @@
 
 #include "string.h"
 
+static size_t	entity(const char *, char *, int);
+static size_t	utf8(uint32_t, char *);
+
+/* Lowercase copy of s, for matching without regard to case */
+char *
+foldstr(const char *s)
+{
+	wchar_t *w;
+	char *f;
+	size_t len, i, n;
+
+	len = strlen(s) + 1;
+	w = malloc(len * sizeof(wchar_t));
+	if (w == NULL)
+		err(1, NULL);
+	n = mbstowcs(w, s, len);
+	if (n == (size_t)-1) {
+		/* Not valid in the locale, fold ASCII only */
+		free(w);
+		f = malloc(len * sizeof(char));
+		if (f == NULL)
+			err(1, NULL);
+		for (i = 0; i < len; i++)
+			f[i] = (char)tolower((unsigned char)s[i]);
+		return f;
+	}
+	for (i = 0; i < n; i++)
+		w[i] = (wchar_t)towlower((wint_t)w[i]);
+	len = n * MB_CUR_MAX + 1;
+	f = malloc(len * sizeof(char));
+	if (f == NULL)
+		err(1, NULL);
+	if (wcstombs(f, w, len) == (size_t)-1)
+		f[0] = '\0';
+	free(w);
+
+	return f;
+}
+
 size_t
 intlen(int i)
 {
@@ -79,3 +118,213 @@ wwrap(wchar_t **s, const int maxwidth)
 
 	return SUCCESS;
 }
+
+/* Copy of s as it is displayed: HTML entities are decoded, tabs become
+ * spaces and other control characters are removed.  Line breaks are
+ * kept if multiline is TRUE, otherwise they become spaces as well.
+ */
+char *
+normstr(const char *s, int multiline)
+{
+	const unsigned char *p;
+	char *n;
+	size_t len, i;
+
+	/* An entity never decodes to more bytes than it takes */
+	len = strlen(s) + 1;
+	n = malloc(len * sizeof(char));
+	if (n == NULL)
+		err(1, NULL);
+
+	for (p = (const unsigned char *)s, i = 0; *p != '\0';) {
+		if (*p == '&' && (len = entity((const char *)p, n + i,
+		    multiline)) > 0) {
+			while (n[i] != '\0')
+				i++;
+			p += len;
+		} else if (*p == '\r' || *p == '\n') {
+			n[i++] = multiline == TRUE ? '\n' : ' ';
+			p += *p == '\r' && p[1] == '\n' ? 2 : 1;
+		} else if (*p == '\t') {
+			n[i++] = ' ';
+			p++;
+		} else if (*p < 0x20 || *p == 0x7f)
+			p++;
+		else if (*p == 0xc2 && p[1] >= 0x80 && p[1] <= 0x9f)
+			p += 2;		/* C1 control character */
+		else
+			n[i++] = (char)*p++;
+	}
+	n[i] = '\0';
+
+	return n;
+}
+
+/* Convert s, as returned by normstr(), to its wide display form and
+ * note the columns of each character and where lines may break.
+ */
+void
+text_init(struct text *t, const char *s)
+{
+	mbstate_t ps;
+	wchar_t wc;
+	size_t len, n, i;
+	int w;
+
+	len = strlen(s);
+	t->s = malloc((len + 1) * sizeof(wchar_t));
+	t->meta = malloc((len + 1) * sizeof(unsigned char));
+	if (t->s == NULL || t->meta == NULL)
+		err(1, NULL);
+	t->width = 0;
+
+	memset(&ps, 0, sizeof(ps));
+	for (i = 0; len > 0; s += n, len -= n) {
+		n = mbrtowc(&wc, s, len, &ps);
+		if (n == (size_t)-1 || n == (size_t)-2) {
+			memset(&ps, 0, sizeof(ps));
+			wc = L'\uFFFD';
+			n = 1;
+		}
+		if (wc == L'\n') {
+			t->s[i] = wc;
+			t->meta[i++] = TEXT_NEWLINE;
+			continue;
+		}
+		w = wcwidth(wc);
+		if (w < 0)
+			continue;	/* Not printable */
+		t->s[i] = wc;
+		t->meta[i] = (unsigned char)w;
+		if (wc == L' ')
+			t->meta[i] |= TEXT_SPACE;
+		t->width += w;
+		i++;
+	}
+	t->s[i] = L'\0';
+	t->len = i;
+}
+
+void
+text_free(struct text *t)
+{
+	free(t->s);
+	free(t->meta);
+	t->s = NULL;
+	t->meta = NULL;
+	t->len = 0;
+}
+
+/* The number of characters from pos that fit into a line of cols
+ * columns, breaking at the last space if possible.  next is set to
+ * where the following line starts.
+ */
+size_t
+text_wrap(const struct text *t, size_t pos, int cols, size_t *next)
+{
+	size_t i, brk;
+	int col, w;
+
+	brk = pos;
+	for (i = pos, col = 0; i < t->len; i++) {
+		if ((t->meta[i] & TEXT_NEWLINE) != 0) {
+			*next = i + 1;
+			return i - pos;
+		}
+		w = t->meta[i] & TEXT_WIDTH;
+		if (col + w > cols) {
+			if (brk > pos) {
+				*next = brk + 1;
+				return brk - pos;
+			}
+			if (i == pos)
+				i++;	/* Wider than the line */
+			*next = i;
+			return i - pos;
+		}
+		if ((t->meta[i] & TEXT_SPACE) != 0)
+			brk = i;
+		col += w;
+	}
+	*next = t->len;
+
+	return t->len - pos;
+}
+
+/* Decode the HTML entity at s into out.  Returns the bytes it takes, or
+ * 0 if it is not one.  Entities of control characters are not decoded,
+ * except a line break if multiline is TRUE.
+ */
+static size_t
+entity(const char *s, char *out, int multiline)
+{
+	const struct {
+		const char	*name;
+		uint32_t	 c;
+	} names[] = {
+		{ "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' },
+		{ "&quot;", '"' }, { "&apos;", '\'' }, { "&nbsp;", ' ' }
+	};
+	unsigned long c;
+	char *ep;
+	size_t i, n;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		n = strlen(names[i].name);
+		if (strncmp(s, names[i].name, n) == 0) {
+			out[utf8(names[i].c, out)] = '\0';
+			return n;
+		}
+	}
+	if (s[1] != '#')
+		return 0;
+	if (s[2] == 'x' || s[2] == 'X') {
+		if (!isxdigit((unsigned char)s[3]))
+			return 0;
+		c = strtoul(s + 3, &ep, 16);
+	} else {
+		if (!isdigit((unsigned char)s[2]))
+			return 0;
+		c = strtoul(s + 2, &ep, 10);
+	}
+	if (*ep != ';' || c == 0 || c > 0x10ffff ||
+	    (c >= 0xd800 && c <= 0xdfff))
+		return 0;
+	if ((c < 0x20 && (c != '\n' || multiline == FALSE)) ||
+	    (c >= 0x7f && c <= 0x9f))
+		return 0;
+
+	/* Numbered entities take at least four bytes, enough for UTF-8 */
+	n = (size_t)(ep + 1 - s);
+	if (utf8((uint32_t)c, out) > n)
+		return 0;
+	out[utf8((uint32_t)c, out)] = '\0';
+
+	return n;
+}
+
+static size_t
+utf8(uint32_t c, char *out)
+{
+	if (c < 0x80) {
+		out[0] = (char)c;
+		return 1;
+	}
+	if (c < 0x800) {
+		out[0] = (char)(0xc0 | c >> 6);
+		out[1] = (char)(0x80 | (c & 0x3f));
+		return 2;
+	}
+	if (c < 0x10000) {
+		out[0] = (char)(0xe0 | c >> 12);
+		out[1] = (char)(0x80 | (c >> 6 & 0x3f));
+		out[2] = (char)(0x80 | (c & 0x3f));
+		return 3;
+	}
+	out[0] = (char)(0xf0 | c >> 18);
+	out[1] = (char)(0x80 | (c >> 12 & 0x3f));
+	out[2] = (char)(0x80 | (c >> 6 & 0x3f));
+	out[3] = (char)(0x80 | (c & 0x3f));
+
+	return 4;
+}
@@ -4,12 +4,25 @@
 #define STRING_H
 
 #include <bsd/string.h>
+#include <ctype.h>
 #include <err.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <wchar.h>
+#include <wctype.h>
 #include "defs.h"
 
+/* Per character information of a display form */
+#define TEXT_WIDTH	0x03	/* Columns */
+#define TEXT_SPACE	0x40	/* A line may break here, dropping it */
+#define TEXT_NEWLINE	0x80	/* A line breaks here */
+
+char	*foldstr(const char *);
 size_t	intlen(int);
+char	*normstr(const char *, int);
+void	text_free(struct text *);
+void	text_init(struct text *, const char *);
+size_t	text_wrap(const struct text *, size_t, int, size_t *);
 int	wwrap(wchar_t **, const int);
 
 #endif
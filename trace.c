@@ -0,0 +1,200 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "trace.h"
+
+static int	trace_claim(void);
+static void	trace_crash(int);
+static void	trace_release(void *);
+static void	trace_signal(int);
+
+/* Every thread records into its own ring of TRACESIZE events, so
+ * recording takes no lock: only the owning thread writes a ring and
+ * publishes the new head with a release store.  A thread gives its ring
+ * back when it ends, the next thread to take it counts up the
+ * generation.  While TRACETHREADS threads hold a ring, others are not
+ * traced.  The dump only uses async-signal-safe calls, it also runs
+ * from the signal handlers.
+ */
+static struct tracering {
+	uint64_t	head;
+	uint32_t	generation;
+	int		used;
+	struct traceev	ev[TRACESIZE];
+}			 trace_rings[TRACETHREADS];
+static uint32_t		 trace_threads = 0;	/* Rings ever taken */
+static __thread int	 trace_slot = -1;
+static pthread_key_t	 trace_key;
+static int		 trace_keyed = FALSE;
+static char		 trace_path[PATH_MAX];
+static int		 trace_enabled = FALSE;
+
+void
+trace_event(int type, uint32_t a, uint64_t b)
+{
+	struct tracering *r;
+	struct traceev *ev;
+	uint64_t head;
+
+	if (trace_slot == -1 && trace_claim() == ERROR)
+		return;
+
+	r = &trace_rings[trace_slot];
+	head = r->head;
+	ev = &r->ev[head % TRACESIZE];
+	ev->time = monotime();
+	ev->type = (uint32_t)type;
+	ev->a = a;
+	ev->b = b;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void
+trace_dump(void)
+{
+	struct tracehdr hdr;
+	struct traceringhdr rh;
+	struct tracering *r;
+	uint64_t head, first;
+	uint32_t i, n;
+	size_t off;
+	int fd;
+
+	if (trace_enabled == FALSE)
+		return;
+	fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+		return;
+
+	n = __atomic_load_n(&trace_threads, __ATOMIC_RELAXED);
+	if (n > TRACETHREADS)
+		n = TRACETHREADS;
+	memcpy(hdr.magic, TRACEMAGIC, sizeof(hdr.magic));
+	hdr.threads = n;
+	hdr.size = TRACESIZE;
+	(void)write(fd, &hdr, sizeof(hdr));
+
+	for (i = 0; i < n; i++) {
+		r = &trace_rings[i];
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		first = head > TRACESIZE ? head - TRACESIZE : 0;
+		rh.thread = i;
+		rh.count = (uint32_t)(head - first);
+		rh.generation = __atomic_load_n(&r->generation,
+		    __ATOMIC_RELAXED);
+		(void)write(fd, &rh, sizeof(rh));
+
+		/* Oldest events first, they may wrap around the ring */
+		off = first % TRACESIZE;
+		if (off + rh.count > TRACESIZE) {
+			(void)write(fd, &r->ev[off],
+			    (TRACESIZE - off) * sizeof(struct traceev));
+			(void)write(fd, r->ev, (off + rh.count - TRACESIZE) *
+			    sizeof(struct traceev));
+		} else
+			(void)write(fd, &r->ev[off],
+			    rh.count * sizeof(struct traceev));
+	}
+	(void)close(fd);
+}
+
+/* Set up the dump file and the signal handlers.  Called before any
+ * thread is started.
+ */
+void
+trace_init(void)
+{
+	struct sigaction sa;
+	const int crash[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+	size_t i;
+
+	if (pthread_key_create(&trace_key, trace_release) == 0)
+		trace_keyed = TRUE;
+	if (datadir(trace_path, sizeof(trace_path), "") == ERROR)
+		return;
+	(void)strlcat(trace_path, "trace", sizeof(trace_path));
+	trace_enabled = TRUE;
+
+	memset(&sa, 0, sizeof(sa));
+	(void)sigemptyset(&sa.sa_mask);
+	sa.sa_handler = trace_signal;
+	sa.sa_flags = SA_RESTART;
+	(void)sigaction(SIGUSR1, &sa, NULL);
+
+	sa.sa_handler = trace_crash;
+	sa.sa_flags = SA_RESETHAND;
+	for (i = 0; i < sizeof(crash) / sizeof(crash[0]); i++)
+		(void)sigaction(crash[i], &sa, NULL);
+}
+
+/* Called by VLC on its event thread */
+void
+trace_vlc(const libvlc_event_t *ev, void *arg)
+{
+	(void)arg;
+
+	if (ev->type == libvlc_MediaPlayerBuffering)
+		trace_event(TR_VLC, (uint32_t)ev->type,
+		    (uint64_t)ev->u.media_player_buffering.new_cache);
+	else
+		trace_event(TR_VLC, (uint32_t)ev->type, 0);
+}
+
+/* Take a free ring for the calling thread */
+static int
+trace_claim(void)
+{
+	struct tracering *r;
+	uint32_t i, n, generation;
+	int used;
+
+	for (i = 0; i < TRACETHREADS; i++) {
+		r = &trace_rings[i];
+		used = FALSE;
+		if (__atomic_load_n(&r->used, __ATOMIC_RELAXED) == TRUE ||
+		    !__atomic_compare_exchange_n(&r->used, &used, TRUE, 0,
+		    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			continue;
+
+		n = __atomic_load_n(&trace_threads, __ATOMIC_RELAXED);
+		while (n < i + 1 && !__atomic_compare_exchange_n(
+		    &trace_threads, &n, i + 1, 0, __ATOMIC_RELAXED,
+		    __ATOMIC_RELAXED))
+			;
+		generation = __atomic_add_fetch(&r->generation, 1,
+		    __ATOMIC_RELAXED);
+		trace_slot = (int)i;
+		if (trace_keyed == TRUE)
+			(void)pthread_setspecific(trace_key, r);
+		trace_event(TR_THREAD, generation, 0);
+
+		return SUCCESS;
+	}
+
+	return ERROR;
+}
+
+/* Dump, then let the default action of the signal end the program */
+static void
+trace_crash(int sig)
+{
+	trace_dump();
+	(void)raise(sig);
+}
+
+/* Give the ring of an ending thread back */
+static void
+trace_release(void *arg)
+{
+	struct tracering *r;
+
+	r = (struct tracering *)arg;
+	__atomic_store_n(&r->used, FALSE, __ATOMIC_RELEASE);
+}
+
+static void
+trace_signal(int sig)
+{
+	(void)sig;
+
+	trace_dump();
+}
@@ -0,0 +1,60 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <bsd/string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <vlc/vlc.h>
+#include "defs.h"
+#include "util.h"
+
+#define TRACEMAGIC	"8ptrace2"
+
+/* Event types, the meaning of a and b is given per type */
+enum tracetypes {
+	TR_STATE,	/* a: new state, b: previous state */
+	TR_KEY,		/* a: key, b: get_wch() result */
+	TR_FETCH,	/* a: endpoint */
+	TR_FETCHED,	/* a: endpoint, b: CURLcode */
+	TR_STREAM,	/* a: track id, b: offset */
+	TR_STREAMED,	/* a: track id, b: CURLcode */
+	TR_VLC,		/* a: VLC event, b: buffering in percent */
+	TR_REDRAW,	/* b: nanoseconds */
+	TR_THREAD,	/* a: generation of the ring, a thread took it */
+	TR_MAX
+};
+
+/* The dump file is the header, then per ring a tracering header and
+ * its events from oldest to newest.  A ring is reused by the threads
+ * started after its thread ended, TR_THREAD marks where each begins.
+ */
+struct tracehdr {
+	char		magic[8];
+	uint32_t	threads;
+	uint32_t	size;		/* Events per ring */
+};
+struct traceringhdr {
+	uint32_t	thread;
+	uint32_t	count;
+	uint32_t	generation;	/* Of the last thread */
+};
+struct traceev {
+	uint64_t	time;		/* Monotonic nanoseconds */
+	uint32_t	type;
+	uint32_t	a;
+	uint64_t	b;
+};
+
+void	trace_dump(void);
+void	trace_event(int, uint32_t, uint64_t);
+void	trace_init(void);
+void	trace_vlc(const libvlc_event_t *, void *);
+
+#endif
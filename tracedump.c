@@ -0,0 +1,101 @@
+/* See LICENSE file for copyright and license details. */
+
+/* 8p-trace: print the events of an 8p trace dump in time order */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+struct event {
+	uint32_t	thread;
+	uint32_t	generation;
+	struct traceev	ev;
+};
+
+static int	cmp(const void *, const void *);
+
+static const char *names[TR_MAX] = {"state", "key", "fetch", "fetched",
+    "stream", "streamed", "vlc", "redraw", "thread"};
+
+int
+main(int argc, char *argv[])
+{
+	FILE *fp;
+	struct tracehdr hdr;
+	struct traceringhdr rh;
+	struct event *events;
+	size_t count, first, i;
+	uint32_t t, j, generation;
+
+	if (argc != 2) {
+		(void)fprintf(stderr, "usage: 8p-trace file\n");
+		return 1;
+	}
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL)
+		err(1, "%s", argv[1]);
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    memcmp(hdr.magic, TRACEMAGIC, sizeof(hdr.magic)) != 0)
+		errx(1, "%s: not an 8p trace", argv[1]);
+
+	/* Merge the rings of all threads */
+	events = NULL;
+	count = 0;
+	for (t = 0; t < hdr.threads; t++) {
+		if (fread(&rh, sizeof(rh), 1, fp) != 1 || rh.count > hdr.size)
+			errx(1, "%s: truncated trace", argv[1]);
+		events = realloc(events, (count + rh.count) *
+		    sizeof(struct event));
+		if (events == NULL && count + rh.count > 0)
+			err(1, NULL);
+		first = count;
+		for (j = 0; j < rh.count; j++, count++) {
+			events[count].thread = rh.thread;
+			if (fread(&events[count].ev, sizeof(struct traceev), 1,
+			    fp) != 1)
+				errx(1, "%s: truncated trace", argv[1]);
+		}
+
+		/* Tell the threads that used the ring apart, counting back
+		 * from the last one
+		 */
+		generation = rh.generation;
+		for (i = count; i-- > first;) {
+			events[i].generation = generation;
+			if (events[i].ev.type == TR_THREAD && generation > 0)
+				generation--;
+		}
+	}
+	(void)fclose(fp);
+	if (count == 0)
+		return 0;
+	qsort(events, count, sizeof(struct event), cmp);
+
+	for (i = 0; i < count; i++) {
+		(void)printf("%14.6f  %2u.%-4u  ",
+		    (events[i].ev.time - events[0].ev.time) / 1e6,
+		    events[i].thread, events[i].generation);
+		if (events[i].ev.type < TR_MAX)
+			(void)printf("%-9s", names[events[i].ev.type]);
+		else
+			(void)printf("%-9u", events[i].ev.type);
+		(void)printf("  %10u  %llu\n", events[i].ev.a,
+		    (unsigned long long)events[i].ev.b);
+	}
+	free(events);
+
+	return 0;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+	uint64_t x, y;
+
+	x = ((const struct event *)a)->ev.time;
+	y = ((const struct event *)b)->ev.time;
+
+	return x < y ? -1 : x > y;
+}
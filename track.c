@@ -8,6 +8,7 @@ track_create(json_t *root)
 	json_t *last, *skip_allowed, *track;
 	json_t *id, *name, *performer, *url;
 	struct track *t;
+	char *title;
 	size_t len;
 
 	if (root == NULL)
@@ -32,10 +33,10 @@ track_create(json_t *root)
 	if (id == NULL)
 		goto error;
 	name = json_object_get(track, "name");
-	if (name == NULL)
+	if (!json_is_string(name))
 		goto error;
 	performer = json_object_get(track, "performer");
-	if (performer == NULL)
+	if (!json_is_string(performer))
 		goto error;
 	url = json_object_get(track, "track_file_stream_url");
 	if (url == NULL)
@@ -44,17 +45,17 @@ track_create(json_t *root)
 	/* Set track information */
 	t->id = json_integer_value(id);
 
-	len = strlen(json_string_value(name)) + 1;
-	t->name = malloc(len * sizeof(char));
-	if (t->name == NULL)
+	/* Text is normalized once, here, not when it is drawn */
+	t->name = normstr(json_string_value(name), FALSE);
+	t->performer = normstr(json_string_value(performer), FALSE);
+	complete_add("artist", t->performer);
+	len = strlen(t->performer) + strlen(" - ") + strlen(t->name) + 1;
+	title = malloc(len * sizeof(char));
+	if (title == NULL)
 		err(1, NULL);
-	(void)strlcpy(t->name, json_string_value(name), len);
-
-	len = strlen(json_string_value(performer)) + 1;
-	t->performer = malloc(len * sizeof(char));
-	if (t->performer == NULL)
-		err(1, NULL);
-	(void)strlcpy(t->performer, json_string_value(performer), len);
+	(void)snprintf(title, len, "%s - %s", t->performer, t->name);
+	text_init(&t->title, title);
+	free(title);
 
 	len = strlen(json_string_value(url)) + 1;
 	t->url = malloc(len * sizeof(char));
@@ -83,5 +84,7 @@ track_free(struct track *t)
 
 	free(t->name);
 	free(t->performer);
+	text_free(&t->title);
 	free(t->url);
+	free(t);
 }
@@ -8,7 +8,9 @@
 #include <jansson.h>
 #include <stdlib.h>
 #include <string.h>
+#include "complete.h"
 #include "defs.h"
+#include "string.h"
 
 struct track	*track_create(json_t *);
 void		 track_free(struct track *);
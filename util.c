@@ -2,62 +2,129 @@
 
 #include "util.h"
 
+/* Obtain a play token.  This may be called from any thread: only one
+ * of them fetches the token, the others wait for its result.
+ */
 int
 setplaytoken(struct info *data)
 {
-	char *js;
-	char url[] = "http://8tracks.com/sets/new";
-	int errn;
+	struct apiargs args;
+	char *token;
 	size_t len;
-	json_t *root, *playtoken, *status;
+	json_t *root, *playtoken;
 
-	if (data->playtoken)
+	(void)pthread_mutex_lock(&data->token_lock);
+	while (data->token_busy == TRUE)
+		(void)pthread_cond_wait(&data->token_cond, &data->token_lock);
+	if (data->playtoken) {
+		(void)pthread_mutex_unlock(&data->token_lock);
 		return SUCCESS;
+	}
+	data->token_busy = TRUE;
+	(void)pthread_mutex_unlock(&data->token_lock);
 
-	js = NULL;
-	root = NULL;
+	token = NULL;
 
-	/* Fetch url */
-	js = malloc(1);
-	if (js == NULL)
-		err(1, NULL);
-	errn = fetch(&js, url);
-	if (errn == ERROR)
-		goto error;
-
-	/* Parse json string */
-	root = json_loads(js, 0, NULL);
+	/* Fetch a new play token */
+	memset(&args, 0, sizeof(args));
+	root = api_get(API_NEWSET, &args, &playtoken);
 	if (root == NULL)
 		goto error;
-	status = json_object_get(root, "status");
-	if (strcmp(json_string_value(status), "200 OK") != 0)
-		goto error;
-	playtoken = json_object_get(root, "play_token");
-	if (playtoken == NULL)
+	if (!json_is_string(playtoken)) {
+		json_decref(root);
 		goto error;
+	}
 
 	/* Set playtoken */
 	len = strlen(json_string_value(playtoken)) + 1;
-	data->playtoken = malloc(len * sizeof(char));
-	if (data->playtoken == NULL)
+	token = malloc(len * sizeof(char));
+	if (token == NULL)
 		err(1, NULL);
-	(void)strlcpy(data->playtoken, json_string_value(playtoken), len);
+	(void)strlcpy(token, json_string_value(playtoken), len);
 
 	/* Cleanup */
-	free(js);
 	json_decref(root);
 
+	(void)pthread_mutex_lock(&data->token_lock);
+	data->playtoken = token;
+	data->token_busy = FALSE;
+	(void)pthread_cond_broadcast(&data->token_cond);
+	(void)pthread_mutex_unlock(&data->token_lock);
+
 	return SUCCESS;
 
 error:
-	if (js)
-		free(js);
-	if (root)
-		json_decref(root);
+	(void)pthread_mutex_lock(&data->token_lock);
+	data->token_busy = FALSE;
+	(void)pthread_cond_broadcast(&data->token_cond);
+	(void)pthread_mutex_unlock(&data->token_lock);
 
 	return ERROR;
 }
 
+/* Set path to the 8p cache directory or one of its subdirectories,
+ * creating the directories that do not exist yet.
+ */
+int
+datadir(char *path, size_t len, const char *sub)
+{
+	const char *base;
+	char *p;
+	int n;
+
+	base = getenv("XDG_CACHE_HOME");
+	if (base != NULL && *base != '\0')
+		n = snprintf(path, len, "%s/8p/%s", base, sub);
+	else {
+		base = getenv("HOME");
+		if (base == NULL || *base == '\0')
+			return ERROR;
+		n = snprintf(path, len, "%s/.cache/8p/%s", base, sub);
+	}
+	if (n < 0 || (size_t)n >= len)
+		return ERROR;
+
+	for (p = path + 1; *p != '\0'; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+			*p = '/';
+			return ERROR;
+		}
+		*p = '/';
+	}
+	if (mkdir(path, 0755) == -1 && errno != EEXIST)
+		return ERROR;
+
+	return SUCCESS;
+}
+
+/* Bytes of the heap in use */
+uint64_t
+heapinuse(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 mi;
+
+	mi = mallinfo2();
+
+	return (uint64_t)mi.uordblks;
+#else
+	return 0;
+#endif
+}
+
+uint64_t
+monotime(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
 int
 mod(int a, int b)
 {
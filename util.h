@@ -3,15 +3,26 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <sys/stat.h>
 #include <bsd/string.h>
 #include <err.h>
+#include <errno.h>
 #include <jansson.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "api.h"
 #include "defs.h"
 #include "fetch.h"
 
-int	setplaytoken(struct info *);
-int	mod(int, int);
+int		datadir(char *, size_t, const char *);
+uint64_t	heapinuse(void);
+int		setplaytoken(struct info *);
+int		mod(int, int);
+uint64_t	monotime(void);
 
 #endif
@@ -0,0 +1,213 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "vlc.h"
+
+static int		 file_play(struct info *, struct track *);
+static int		 vlc_init(struct info *);
+static void		 vlc_exit(struct info *);
+static libvlc_media_t	*vlc_media(struct info *, struct track *);
+static void		 vlc_pause(struct info *);
+static int		 vlc_play(struct info *, struct track *);
+static void		 vlc_position(struct info *, long long *, long long *,
+			    int *);
+static int		 vlc_state(struct info *);
+static void		 vlc_stop(struct info *);
+
+const struct audio audio_vlc = {
+	"vlc",
+	vlc_init,
+	vlc_exit,
+	vlc_play,
+	vlc_stop,
+	vlc_pause,
+	vlc_position,
+	vlc_state
+};
+
+/* The file sink decodes each track with VLC into a WAV file instead of
+ * playing it.  Writing a file is not paced by the audio clock, so a
+ * track is done as fast as it can be downloaded and decoded.
+ */
+const struct audio audio_file = {
+	"file",
+	vlc_init,
+	vlc_exit,
+	file_play,
+	vlc_stop,
+	vlc_pause,
+	vlc_position,
+	vlc_state
+};
+
+/* A reduced VLC configuration: no video output, interfaces or Lua
+ * scripts.  Loading and probing those modules dominates libvlc_new().
+ */
+static const char *const vlc_args[] = {
+	"--quiet",
+	"--no-video",
+	"--no-xlib",
+	"--no-lua",
+	"--no-stats",
+	"--intf=dummy"
+};
+
+/* Player events recorded in the trace */
+static const int vlc_traced[] = {
+	libvlc_MediaPlayerBuffering,
+	libvlc_MediaPlayerPlaying,
+	libvlc_MediaPlayerEndReached,
+	libvlc_MediaPlayerEncounteredError
+};
+
+static int
+file_play(struct info *data, struct track *t)
+{
+	char opt[PATH_MAX + 128];
+	libvlc_media_t *media;
+	int n;
+
+	media = vlc_media(data, t);
+	if (media == NULL)
+		return ERROR;
+	n = snprintf(opt, sizeof(opt),
+	    ":sout=#transcode{acodec=s16l}:std{access=file,mux=wav,"
+	    "dst='%s/%d-%d.wav'}", data->audio_arg, data->zone, t->id);
+	if (n < 0 || (size_t)n >= sizeof(opt)) {
+		libvlc_media_release(media);
+		return ERROR;
+	}
+	libvlc_media_add_option(media, opt);
+	libvlc_media_player_set_media(data->vlc_mp, media);
+	(void)libvlc_media_player_play(data->vlc_mp);
+	libvlc_media_release(media);
+
+	return SUCCESS;
+}
+
+/* Set up one VLC instance with a media player for every zone */
+static int
+vlc_init(struct info *data)
+{
+	struct info *z;
+	libvlc_instance_t *inst;
+	libvlc_event_manager_t *em;
+	size_t i;
+
+	for (z = data; z != NULL; z = z->zone_next) {
+		z->vlc_inst = NULL;
+		z->vlc_mp = NULL;
+	}
+
+	if (data->vlc_full == TRUE)
+		inst = libvlc_new(0, NULL);
+	else
+		inst = libvlc_new(sizeof(vlc_args) / sizeof(vlc_args[0]),
+		    vlc_args);
+	if (inst == NULL)
+		return ERROR;
+
+	for (z = data; z != NULL; z = z->zone_next) {
+		z->vlc_mp = libvlc_media_player_new(inst);
+		if (z->vlc_mp == NULL)
+			continue;
+		if (z->zone_device != NULL)
+			(void)libvlc_audio_output_device_set(z->vlc_mp, NULL,
+			    z->zone_device);
+		em = libvlc_media_player_event_manager(z->vlc_mp);
+		(void)libvlc_event_attach(em, libvlc_MediaPlayerBuffering,
+		    hud_buffering, NULL);
+		for (i = 0; i < sizeof(vlc_traced) / sizeof(vlc_traced[0]);
+		    i++)
+			(void)libvlc_event_attach(em, vlc_traced[i],
+			    trace_vlc, NULL);
+
+		/* Every zone holds a reference to the instance */
+		if (z != data)
+			libvlc_retain(inst);
+		z->vlc_inst = inst;
+		z->audio_status = SUCCESS;
+	}
+	if (data->vlc_inst == NULL)
+		libvlc_release(inst);
+
+	return SUCCESS;
+}
+
+static void
+vlc_exit(struct info *data)
+{
+	libvlc_media_player_release(data->vlc_mp);
+	libvlc_release(data->vlc_inst);
+}
+
+/* Media for a track: from the disk cache if possible, else through the
+ * read-ahead stream or streamed by VLC itself.
+ */
+static libvlc_media_t *
+vlc_media(struct info *data, struct track *t)
+{
+	char path[PATH_MAX];
+
+	if (cache_lookup(t->id, path, sizeof(path)) == TRUE)
+		return libvlc_media_new_path(data->vlc_inst, path);
+	if (data->stream_size > 0) {
+		data->stream = stream_create(t->url, t->id, data->stream_size,
+		    data->stream_mmap);
+		return libvlc_media_new_callbacks(data->vlc_inst, stream_open,
+		    stream_read, stream_seek, stream_close,
+		    (void *)data->stream);
+	}
+
+	return libvlc_media_new_location(data->vlc_inst, t->url);
+}
+
+static void
+vlc_pause(struct info *data)
+{
+	libvlc_media_player_pause(data->vlc_mp);
+}
+
+static int
+vlc_play(struct info *data, struct track *t)
+{
+	libvlc_media_t *media;
+
+	media = vlc_media(data, t);
+	if (media == NULL)
+		return ERROR;
+	libvlc_media_player_set_media(data->vlc_mp, media);
+	(void)libvlc_media_player_play(data->vlc_mp);
+	libvlc_media_release(media);
+
+	return SUCCESS;
+}
+
+static void
+vlc_position(struct info *data, long long *time, long long *length,
+    int *paused)
+{
+	*time = (long long)libvlc_media_player_get_time(data->vlc_mp);
+	*length = (long long)libvlc_media_player_get_length(data->vlc_mp);
+	*paused = libvlc_media_player_get_state(data->vlc_mp) ==
+	    libvlc_Paused ? TRUE : FALSE;
+}
+
+static int
+vlc_state(struct info *data)
+{
+	switch (libvlc_media_player_get_state(data->vlc_mp)) {
+	case libvlc_Opening:	/* FALLTHROUGH */
+	case libvlc_Buffering:	/* FALLTHROUGH */
+	case libvlc_Playing:	return AUDIO_PLAYING;
+	case libvlc_Paused:	return AUDIO_PAUSED;
+	case libvlc_Ended:	/* FALLTHROUGH */
+	case libvlc_Error:	return AUDIO_ENDED;
+	default:		return AUDIO_IDLE;
+	}
+}
+
+static void
+vlc_stop(struct info *data)
+{
+	libvlc_media_player_stop(data->vlc_mp);
+}
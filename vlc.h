@@ -0,0 +1,18 @@
+/* See LICENSE file for copyright and license details. */
+
+#ifndef VLC_H
+#define VLC_H
+
+#include <limits.h>
+#include <stdio.h>
+#include <vlc/vlc.h>
+#include "audio.h"
+#include "cache.h"
+#include "defs.h"
+#include "hud.h"
+#include "mix.h"
+#include "stream.h"
+#include "trace.h"
+#include "util.h"
+
+#endif